@@ -0,0 +1,284 @@
+/*
+ * Load times of textures as raw TGA, RLE TGA and QOI, results are written as JSON
+ * usage: qoi-bench [-o results.json] [-time seconds] files.tga...
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "targa.h"
+#include "qoi.h"
+
+#define BENCH_RLE_FILE "qoi_bench.tmp.tga"
+#define BENCH_QOI_FILE "qoi_bench.tmp.qoi"
+
+enum BENCH_ENCODING
+{
+    BENCH_ENCODING_TGA,             // the file as it is, load_targa
+    BENCH_ENCODING_TGA_RLE,         // the same pixels RLE encoded, load_targa
+    BENCH_ENCODING_QOI,             // load_qoi
+    BENCH_ENCODINGS_COUNT
+};
+
+static const char *bench_encodings[BENCH_ENCODINGS_COUNT] = {"tga", "tga-rle", "qoi"};
+
+struct bench_result
+{
+    double      best;               // seconds per load
+    double      mean;
+    int         iterations;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int write_file(const char *path, const void *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if(!fp)
+        return 0;
+
+    const int written = fwrite(data, 1, size, fp) == size;
+
+    return !fclose(fp) && written;
+}
+
+static long file_size(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if(!fp)
+        return -1;
+
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fclose(fp);
+
+    return size;
+}
+
+static size_t encode_rle(const uint8_t *pixels, size_t count, int bytesperpixel, uint8_t *out)
+{
+    const uint8_t *start = out;
+    size_t i = 0;
+
+    while(i < count)
+    {
+        size_t run = 1;
+
+        while((i + run < count) && (run < 128) && !memcmp(pixels + i * bytesperpixel, pixels + (i + run) * bytesperpixel, bytesperpixel))
+            run++;
+
+        if(run > 1)
+        {
+            *out++ = (uint8_t)(0x80 | (run - 1));
+            memcpy(out, pixels + i * bytesperpixel, bytesperpixel);
+            out += bytesperpixel;
+            i += run;
+            continue;
+        }
+
+        // raw packets end where the next run starts
+        size_t raw = 1;
+
+        while((i + raw < count) && (raw < 128) &&
+              ((i + raw + 1 >= count) || memcmp(pixels + (i + raw) * bytesperpixel, pixels + (i + raw + 1) * bytesperpixel, bytesperpixel)))
+            raw++;
+
+        *out++ = (uint8_t)(raw - 1);
+        memcpy(out, pixels + i * bytesperpixel, raw * bytesperpixel);
+        out += raw * bytesperpixel;
+        i += raw;
+    }
+
+    return (size_t)(out - start);
+}
+
+static int write_targa_rle(const char *path, const uint8_t *pixels, GLsizei width, GLsizei height, int bytesperpixel)
+{
+    const size_t count = (size_t)width * height;
+    uint8_t *file = (uint8_t*)calloc(1, 18 + count * (bytesperpixel + 1));
+
+    if(!file)
+        return 0;
+
+    file[2] = 10;
+    file[12] = (uint8_t)(width & 0xff);
+    file[13] = (uint8_t)(width >> 8);
+    file[14] = (uint8_t)(height & 0xff);
+    file[15] = (uint8_t)(height >> 8);
+    file[16] = (uint8_t)(bytesperpixel * 8);
+
+    const size_t length = 18 + encode_rle(pixels, count, bytesperpixel, file + 18);
+    const int written = write_file(path, file, length);
+
+    free(file);
+
+    return written;
+}
+
+static int run_load(int encoding, const char *path)
+{
+    GLuint iformat;
+    GLenum format;
+    GLsizei width, height;
+    void *pixels = encoding == BENCH_ENCODING_QOI ? load_qoi(path, &iformat, &format, &width, &height) :
+                                                    load_targa(path, &iformat, &format, &width, &height);
+    const int loaded = pixels != NULL;
+
+    free(pixels);
+
+    return loaded;
+}
+
+static int bench_load(int encoding, const char *path, double min_time, struct bench_result *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    // warm up, also brings the file into the page cache
+    if(!run_load(encoding, path))
+        return 0;
+
+    double total = 0.0;
+
+    result->best = 1e30;
+
+    while((result->iterations < 3) || (total < min_time))
+    {
+        const double start = now();
+
+        run_load(encoding, path);
+
+        const double elapsed = now() - start;
+
+        if(elapsed < result->best)
+            result->best = elapsed;
+
+        total += elapsed;
+        result->iterations++;
+    }
+
+    result->mean = total / result->iterations;
+
+    return 1;
+}
+
+extern int
+main(int argc, char *argv[]) {
+    const char *output = NULL;
+    double min_time = 0.25;
+    int i = 1;
+
+    for(; (i < argc) && (argv[i][0] == '-'); i++)
+    {
+        if(!strcmp(argv[i], "-o") && (i + 1 < argc))
+            output = argv[++i];
+        else if(!strcmp(argv[i], "-time") && (i + 1 < argc))
+            min_time = atof(argv[++i]);
+        else
+            break;
+    }
+
+    if(i == argc)
+    {
+        fprintf(stderr, "usage: %s [-o results.json] [-time seconds] files.tga...\n", argv[0]);
+        return 1;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+
+    if(!out)
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"results\": [");
+
+    int first = 1;
+    int failed = 0;
+    double totals[BENCH_ENCODINGS_COUNT] = {0.0};
+    long sizes[BENCH_ENCODINGS_COUNT] = {0};
+
+    for(; i < argc; i++)
+    {
+        const char *name = argv[i];
+        GLuint iformat;
+        GLenum format;
+        GLsizei width, height;
+        uint8_t *pixels = (uint8_t*)load_targa(name, &iformat, &format, &width, &height);
+        const int bytesperpixel = format == GL_BGR ? 3 : (format == GL_BGRA ? 4 : 0);
+        size_t size = 0;
+        void *qoi = pixels && bytesperpixel ? encode_qoi(pixels, width, height, format, &size) : NULL;
+
+        if(!qoi || !write_file(BENCH_QOI_FILE, qoi, size) || !write_targa_rle(BENCH_RLE_FILE, pixels, width, height, bytesperpixel))
+        {
+            fprintf(stderr, "Can't convert %s\n", name);
+            free(qoi);
+            free(pixels);
+            failed = 1;
+            continue;
+        }
+
+        free(qoi);
+        free(pixels);
+
+        const char *paths[BENCH_ENCODINGS_COUNT] = {name, BENCH_RLE_FILE, BENCH_QOI_FILE};
+        const size_t decoded_size = (size_t)width * height * bytesperpixel;
+
+        for(int k = 0; k < BENCH_ENCODINGS_COUNT; k++)
+        {
+            struct bench_result result;
+            const long length = file_size(paths[k]);
+
+            if(!bench_load(k, paths[k], min_time, &result))
+            {
+                fprintf(stderr, "%s as %s failed to load\n", name, bench_encodings[k]);
+                failed = 1;
+                continue;
+            }
+
+            const double mbps = (double)decoded_size / result.best / 1e6;
+
+            totals[k] += result.best;
+            sizes[k] += length;
+
+            fprintf(stderr, "%-60s %-7s %8ld KiB %8.3f ms %8.1f MB/s\n", name, bench_encodings[k], length / 1024, result.best * 1e3, mbps);
+
+            fprintf(out, "%s\n    {\"file\": \"%s\", \"encoding\": \"%s\", \"width\": %d, \"height\": %d, \"file_bytes\": %ld, "
+                    "\"decoded_bytes\": %zu, \"iterations\": %d, \"best_ms\": %.4f, \"mean_ms\": %.4f, \"mb_per_s\": %.1f}",
+                    first ? "" : ",", name, bench_encodings[k], width, height, length,
+                    decoded_size, result.iterations, result.best * 1e3, result.mean * 1e3, mbps);
+
+            first = 0;
+        }
+
+        remove(BENCH_RLE_FILE);
+        remove(BENCH_QOI_FILE);
+    }
+
+    fprintf(out, "\n  ],\n  \"totals\": [");
+
+    for(int k = 0; k < BENCH_ENCODINGS_COUNT; k++)
+    {
+        fprintf(stderr, "total %-7s %8ld KiB %8.3f ms\n", bench_encodings[k], sizes[k] / 1024, totals[k] * 1e3);
+        fprintf(out, "%s\n    {\"encoding\": \"%s\", \"file_bytes\": %ld, \"best_ms\": %.4f}", k ? "," : "", bench_encodings[k], sizes[k], totals[k] * 1e3);
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if(output)
+        fclose(out);
+
+    return failed;
+}
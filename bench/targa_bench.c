@@ -0,0 +1,523 @@
+/*
+ * Decode throughput of synthetic TGAs, results are written as JSON. Every source ends
+ * with a pass over the decoded pixels, so a raw image viewed in place costs a read of
+ * its pixels like the others instead of nothing.
+ * usage: targa-bench [-o results.json] [-label name] [-max size] [-time seconds]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "targa.h"
+
+#define BENCH_FILE "targa_bench.tmp.tga"
+#define BENCH_BAND_ROWS 64
+
+enum BENCH_SOURCE
+{
+    BENCH_SOURCE_FILE,              // load_targa
+    BENCH_SOURCE_MEMORY,            // map_targa_memory
+    BENCH_SOURCE_STREAM,            // stream_targa in bands of BENCH_BAND_ROWS
+    BENCH_SOURCES_COUNT
+};
+
+static const char *bench_sources[BENCH_SOURCES_COUNT] = {"file", "memory", "stream"};
+
+static const int bench_sizes[] = {64, 256, 1024, 4096, 8192};
+static const int bench_bpps[] = {8, 24, 32};
+
+struct bench_result
+{
+    double      best;               // seconds per decode
+    double      mean;
+    int         iterations;
+    double      allocations;        // per decode, -1 when not counted
+    double      allocated;          // bytes per decode
+    long        peak_rss;           // KiB, -1 when not available
+    long        rss_growth;
+};
+
+// The loader's heap use is counted by wrapping the allocator at link time
+#ifdef BENCH_WRAP_MALLOC
+static size_t allocations;
+static size_t allocated;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void *ptr, size_t size);
+
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void *ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    allocations++;
+    allocated += size;
+
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    allocated += count * size;
+
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    allocated += size;
+
+    return __real_realloc(ptr, size);
+}
+#endif
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Linux only: resets VmHWM to the current RSS
+static void reset_peak_rss(void)
+{
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+
+    if(fp)
+    {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+static long read_rss(const char *field)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    char line[256];
+    long kib = -1;
+
+    if(!fp)
+        return -1;
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        if(!strncmp(line, field, strlen(field)))
+        {
+            kib = strtol(line + strlen(field), NULL, 10);
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return kib;
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *state = x;
+}
+
+// Noise interrupted by flat spans, so RLE sees both kinds of packets
+static void generate_pixels(uint8_t *pixels, size_t count, int bytesperpixel)
+{
+    uint32_t state = 0x9e3779b9u;
+    size_t i = 0;
+
+    while(i < count)
+    {
+        const uint32_t r = next_random(&state);
+        size_t span = 1 + (r >> 8) % 48;
+
+        if(span > count - i)
+            span = count - i;
+
+        if(r & 1)
+        {
+            const uint32_t color = next_random(&state);
+
+            for(size_t k = 0; k < span; k++)
+                memcpy(pixels + (i + k) * bytesperpixel, &color, bytesperpixel);
+        }
+        else
+        {
+            for(size_t k = 0; k < span; k++)
+            {
+                const uint32_t color = next_random(&state);
+                memcpy(pixels + (i + k) * bytesperpixel, &color, bytesperpixel);
+            }
+        }
+
+        i += span;
+    }
+}
+
+static uint8_t* write_header(uint8_t *out, int rle, int bpp, int width, int height)
+{
+    memset(out, 0, 18);
+
+    out[2] = (uint8_t)(bpp == 8 ? (rle ? 11 : 3) : (rle ? 10 : 2));
+    out[12] = (uint8_t)(width & 0xff);
+    out[13] = (uint8_t)(width >> 8);
+    out[14] = (uint8_t)(height & 0xff);
+    out[15] = (uint8_t)(height >> 8);
+    out[16] = (uint8_t)bpp;
+
+    return out + 18;
+}
+
+static size_t encode_rle(const uint8_t *pixels, size_t count, int bytesperpixel, uint8_t *out)
+{
+    const uint8_t *start = out;
+    size_t i = 0;
+
+    while(i < count)
+    {
+        size_t run = 1;
+
+        while((i + run < count) && (run < 128) && !memcmp(pixels + i * bytesperpixel, pixels + (i + run) * bytesperpixel, bytesperpixel))
+            run++;
+
+        if(run > 1)
+        {
+            *out++ = (uint8_t)(0x80 | (run - 1));
+            memcpy(out, pixels + i * bytesperpixel, bytesperpixel);
+            out += bytesperpixel;
+            i += run;
+            continue;
+        }
+
+        // raw packets end where the next run starts
+        size_t raw = 1;
+
+        while((i + raw < count) && (raw < 128) &&
+              ((i + raw + 1 >= count) || memcmp(pixels + (i + raw) * bytesperpixel, pixels + (i + raw + 1) * bytesperpixel, bytesperpixel)))
+            raw++;
+
+        *out++ = (uint8_t)(raw - 1);
+        memcpy(out, pixels + i * bytesperpixel, raw * bytesperpixel);
+        out += raw * bytesperpixel;
+        i += raw;
+    }
+
+    return (size_t)(out - start);
+}
+
+// Returns the TGA file in memory, rle packets in the worst case need a byte per pixel more
+static uint8_t* generate_targa(int rle, int bpp, int size, size_t *length)
+{
+    const int bytesperpixel = bpp / 8;
+    const size_t count = (size_t)size * size;
+    uint8_t *pixels = (uint8_t*)malloc(count * bytesperpixel);
+    uint8_t *file = (uint8_t*)malloc(18 + count * (bytesperpixel + 1));
+
+    if(!pixels || !file)
+    {
+        free(pixels);
+        free(file);
+        return NULL;
+    }
+
+    generate_pixels(pixels, count, bytesperpixel);
+
+    uint8_t *data = write_header(file, rle, bpp, size, size);
+
+    if(rle)
+        *length = 18 + encode_rle(pixels, count, bytesperpixel, data);
+    else
+    {
+        memcpy(data, pixels, count * bytesperpixel);
+        *length = 18 + count * bytesperpixel;
+    }
+
+    free(pixels);
+
+    return file;
+}
+
+static int write_file(const char *path, const uint8_t *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if(!fp)
+        return 0;
+
+    const int written = fwrite(data, 1, size, fp) == size;
+
+    return !fclose(fp) && written;
+}
+
+// Kept so the pixel passes can't be optimized away
+static volatile uint64_t checksum_sink;
+
+static size_t pixel_size(GLenum format)
+{
+    return format == GL_RED ? 1 : (format == GL_BGR ? 3 : 4);
+}
+
+static uint64_t checksum_pixels(const void *pixels, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t*)pixels;
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        sum += word;
+    }
+
+    for(; i < size; i++)
+        sum += bytes[i];
+
+    return sum;
+}
+
+static int checksum_band(const struct targa_image *image, int y, int rows, const void *pixels, void *userdata)
+{
+    (void)y;
+
+    *(uint64_t*)userdata += checksum_pixels(pixels, (size_t)image->width * rows * pixel_size(image->format));
+
+    return 1;
+}
+
+static int run_decode(int source, const uint8_t *data, size_t size)
+{
+    if(source == BENCH_SOURCE_FILE)
+    {
+        GLuint iformat;
+        GLenum format;
+        GLsizei width, height;
+        void *pixels = load_targa(BENCH_FILE, &iformat, &format, &width, &height);
+        const int decoded = pixels != NULL;
+
+        if(decoded)
+            checksum_sink += checksum_pixels(pixels, (size_t)width * height * pixel_size(format));
+
+        free(pixels);
+
+        return decoded;
+    }
+
+    if(source == BENCH_SOURCE_STREAM)
+    {
+        uint64_t sum = 0;
+        const int decoded = stream_targa(BENCH_FILE, BENCH_BAND_ROWS, checksum_band, &sum);
+
+        checksum_sink += sum;
+
+        return decoded;
+    }
+
+    struct targa_image image;
+    const int decoded = map_targa_memory(data, size, &image) != NULL;
+
+    if(decoded)
+        checksum_sink += checksum_pixels(image.pixels, (size_t)image.width * image.height * pixel_size(image.format));
+
+    unmap_targa(&image);
+
+    return decoded;
+}
+
+static int bench_decode(int source, const uint8_t *data, size_t size, double min_time, struct bench_result *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    // warm up, also brings the file into the page cache
+    if(!run_decode(source, data, size))
+        return 0;
+
+    reset_peak_rss();
+    const long rss = read_rss("VmRSS:");
+
+#ifdef BENCH_WRAP_MALLOC
+    allocations = allocated = 0;
+#endif
+
+    double total = 0.0;
+
+    result->best = 1e30;
+
+    for(;;)
+    {
+        const double start = now();
+
+        run_decode(source, data, size);
+
+        const double elapsed = now() - start;
+
+        if(elapsed < result->best)
+            result->best = elapsed;
+
+        total += elapsed;
+        result->iterations++;
+
+        // very large images are timed once when a single decode takes the whole budget
+        if(((result->iterations >= 3) && (total >= min_time)) || (elapsed >= min_time))
+            break;
+    }
+
+    result->mean = total / result->iterations;
+
+#ifdef BENCH_WRAP_MALLOC
+    result->allocations = (double)allocations / result->iterations;
+    result->allocated = (double)allocated / result->iterations;
+#else
+    result->allocations = result->allocated = -1.0;
+#endif
+
+    result->peak_rss = read_rss("VmHWM:");
+    result->rss_growth = (result->peak_rss >= 0) && (rss >= 0) ? result->peak_rss - rss : -1;
+
+    return 1;
+}
+
+// The label comes from the command line
+static void write_json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+
+    for(; *text; text++)
+    {
+        const unsigned char c = (unsigned char)*text;
+
+        if((c == '"') || (c == '\\'))
+            fprintf(out, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+
+    fputc('"', out);
+}
+
+extern int
+main(int argc, char *argv[]) {
+    const char *output = NULL;
+    const char *label = "";
+    int max_size = 8192;
+    double min_time = 0.25;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "-o") && (i + 1 < argc))
+            output = argv[++i];
+        else if(!strcmp(argv[i], "-label") && (i + 1 < argc))
+            label = argv[++i];
+        else if(!strcmp(argv[i], "-max") && (i + 1 < argc))
+            max_size = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-time") && (i + 1 < argc))
+            min_time = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-o results.json] [-label name] [-max size] [-time seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+
+    if(!out)
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"label\": ");
+    write_json_string(out, label);
+    fprintf(out, ",\n  \"allocations_counted\": %s,\n  \"results\": [",
+#ifdef BENCH_WRAP_MALLOC
+            "true"
+#else
+            "false"
+#endif
+            );
+
+    int first = 1;
+    int failed = 0;
+
+    for(size_t s = 0; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]); s++)
+    {
+        const int size = bench_sizes[s];
+
+        if(size > max_size)
+            break;
+
+        for(size_t b = 0; b < sizeof(bench_bpps) / sizeof(bench_bpps[0]); b++)
+        {
+            for(int rle = 0; rle < 2; rle++)
+            {
+                const int bpp = bench_bpps[b];
+                const size_t decoded_size = (size_t)size * size * (bpp / 8);
+                size_t length = 0;
+                uint8_t *data = generate_targa(rle, bpp, size, &length);
+
+                if(!data || !write_file(BENCH_FILE, data, length))
+                {
+                    fprintf(stderr, "Can't generate %dx%d %d bpp\n", size, size, bpp);
+                    free(data);
+                    failed = 1;
+                    continue;
+                }
+
+                for(int k = 0; k < BENCH_SOURCES_COUNT; k++)
+                {
+                    const char *source = bench_sources[k];
+                    struct bench_result result;
+
+                    if(!bench_decode(k, data, length, min_time, &result))
+                    {
+                        fprintf(stderr, "%s %dx%d %d bpp from %s failed to decode\n", rle ? "rle" : "raw", size, size, bpp, source);
+                        failed = 1;
+                        continue;
+                    }
+
+                    const double mbps = (double)decoded_size / result.best / 1e6;
+                    // a raw image in memory is only read in place, never copied
+                    const int zero_copy = !rle && (k == BENCH_SOURCE_MEMORY);
+
+                    fprintf(stderr, "%-3s %2d bpp %5dx%-5d %-6s %10.1f MB/s %6.1f allocs %8ld KiB peak\n",
+                            rle ? "rle" : "raw", bpp, size, size, source, mbps, result.allocations, result.peak_rss);
+
+                    fprintf(out, "%s\n    {\"encoding\": \"%s\", \"bpp\": %d, \"width\": %d, \"height\": %d, \"source\": \"%s\", \"zero_copy\": %s, "
+                            "\"file_bytes\": %zu, \"decoded_bytes\": %zu, \"iterations\": %d, \"best_ms\": %.4f, \"mean_ms\": %.4f, "
+                            "\"mb_per_s\": %.1f, \"allocations\": %.1f, \"allocated_bytes\": %.0f, \"peak_rss_kib\": %ld, \"rss_growth_kib\": %ld}",
+                            first ? "" : ",", rle ? "rle" : "raw", bpp, size, size, source,
+                            zero_copy ? "true" : "false", length, decoded_size, result.iterations, result.best * 1e3, result.mean * 1e3,
+                            mbps, result.allocations, result.allocated, result.peak_rss, result.rss_growth);
+
+                    first = 0;
+                }
+
+                remove(BENCH_FILE);
+                free(data);
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if(output)
+        fclose(out);
+
+    return failed;
+}
@@ -0,0 +1,229 @@
+/*
+ * Cost of the fixed-step update phase for many objects, per step calls against one
+ * on_update_n call per frame, results are written as JSON
+ * usage: update-bench [-o results.json] [-steps per frame] [-time seconds]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TIMESTEP 0.001f
+#define BENCH_BLOCK 1024            // objects stepped together by update_loop
+
+enum BENCH_UPDATE
+{
+    BENCH_UPDATE_STEP,              // on_update per step, every object once per call
+    BENCH_UPDATE_LOOP,              // on_update_n stepping blocks of objects
+    BENCH_UPDATE_CLOSED,            // on_update_n in closed form
+    BENCH_UPDATES_COUNT
+};
+
+static const char *bench_updates[BENCH_UPDATES_COUNT] = {"step", "loop", "closed"};
+
+static const int bench_objects[] = {10000, 100000};
+
+// Same interpolation state as the examples keep, per object
+struct objects
+{
+    int         count;
+    float      *previous;
+    float      *current;
+    float      *speed;
+};
+
+struct bench_result
+{
+    double      best;               // seconds per frame
+    double      mean;
+    int         iterations;
+};
+
+static struct objects objects;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void on_update(float dt)
+{
+    for(int i = 0; i < objects.count; i++)
+    {
+        objects.previous[i] = objects.current[i];
+        objects.current[i] += objects.speed[i] * dt;
+    }
+}
+
+static void update_steps(unsigned int steps, float dt)
+{
+    for(unsigned int i = 0; i < steps; i++)
+        on_update(dt);
+}
+
+// Matches update_steps bit for bit, but all steps run over a block of objects while
+// it is in L1 instead of streaming every object through the cache once per step
+static void update_loop(unsigned int steps, float dt)
+{
+    for(int first = 0; first < objects.count; first += BENCH_BLOCK)
+    {
+        const int count = objects.count - first < BENCH_BLOCK ? objects.count - first : BENCH_BLOCK;
+        float *previous = objects.previous + first, *current = objects.current + first;
+        const float *speed = objects.speed + first;
+
+        for(unsigned int k = 1; k < steps; k++)
+        {
+            for(int i = 0; i < count; i++)
+                current[i] += speed[i] * dt;
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            previous[i] = current[i];
+            current[i] += speed[i] * dt;
+        }
+    }
+}
+
+static void update_closed(unsigned int steps, float dt)
+{
+    for(int i = 0; i < objects.count; i++)
+    {
+        const float step = objects.speed[i] * dt;
+
+        objects.previous[i] = objects.current[i] + step * (float)(steps - 1);
+        objects.current[i] += step * (float)steps;
+    }
+}
+
+// Called through a pointer, like the hooks are called across translation units
+static void (*const bench_functions[BENCH_UPDATES_COUNT])(unsigned int, float) = {update_steps, update_loop, update_closed};
+
+static int init_objects(int count)
+{
+    objects.count = count;
+    objects.previous = (float*)calloc(count, sizeof(float));
+    objects.current = (float*)calloc(count, sizeof(float));
+    objects.speed = (float*)malloc(count * sizeof(float));
+
+    if(!objects.previous || !objects.current || !objects.speed)
+        return 0;
+
+    for(int i = 0; i < count; i++)
+        objects.speed[i] = 0.25f + (float)(i % 64) / 64.0f;
+
+    return 1;
+}
+
+static void free_objects(void)
+{
+    free(objects.previous);
+    free(objects.current);
+    free(objects.speed);
+    memset(&objects, 0, sizeof(objects));
+}
+
+static void bench_update(int update, unsigned int steps, double min_time, struct bench_result *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    // warm up, also faults the arrays in
+    bench_functions[update](steps, TIMESTEP);
+
+    double total = 0.0;
+
+    result->best = 1e30;
+
+    while((result->iterations < 3) || (total < min_time))
+    {
+        const double start = now();
+
+        bench_functions[update](steps, TIMESTEP);
+
+        const double elapsed = now() - start;
+
+        if(elapsed < result->best)
+            result->best = elapsed;
+
+        total += elapsed;
+        result->iterations++;
+    }
+
+    result->mean = total / result->iterations;
+}
+
+extern int
+main(int argc, char *argv[]) {
+    const char *output = NULL;
+    double min_time = 0.25;
+    int steps = 16;                 // a 60 Hz frame of 1 ms steps
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "-o") && (i + 1 < argc))
+            output = argv[++i];
+        else if(!strcmp(argv[i], "-steps") && (i + 1 < argc) && (atoi(argv[i + 1]) > 0))
+            steps = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-time") && (i + 1 < argc))
+            min_time = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-o results.json] [-steps per frame] [-time seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+
+    if(!out)
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"steps_per_frame\": %d,\n  \"results\": [", steps);
+
+    int first = 1;
+
+    for(size_t i = 0; i < sizeof(bench_objects) / sizeof(bench_objects[0]); i++)
+    {
+        const int count = bench_objects[i];
+
+        for(int k = 0; k < BENCH_UPDATES_COUNT; k++)
+        {
+            struct bench_result result;
+
+            if(!init_objects(count))
+            {
+                fprintf(stderr, "Can't allocate %d objects\n", count);
+                free_objects();
+                return 1;
+            }
+
+            bench_update(k, (unsigned int)steps, min_time, &result);
+            free_objects();
+
+            const double ns = result.best * 1e9 / ((double)count * steps);
+
+            fprintf(stderr, "%7d objects %-7s %8.3f ms per frame %7.3f ns per object step\n", count, bench_updates[k], result.best * 1e3, ns);
+
+            fprintf(out, "%s\n    {\"objects\": %d, \"update\": \"%s\", \"iterations\": %d, \"best_ms\": %.4f, \"mean_ms\": %.4f, "
+                    "\"ns_per_object_step\": %.3f}",
+                    first ? "" : ",", count, bench_updates[k], result.iterations, result.best * 1e3, result.mean * 1e3, ns);
+
+            first = 0;
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if(output)
+        fclose(out);
+
+    return 0;
+}
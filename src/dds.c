@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dds.h"
+
+extern size_t dds_level_size(uint32_t fourcc, GLsizei width, GLsizei height)
+{
+    const size_t block_size = fourcc == DDS_FOURCC_DXT1 ? 8 : 16;
+
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+extern int dds_supported(void)
+{
+    static int supported = -1;
+
+    if(supported < 0)
+    {
+        GLint count = 0;
+
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        supported = 0;
+
+        for(GLint i = 0; (i < count) && !supported; i++)
+            supported = !strcmp((const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i), "GL_EXT_texture_compression_s3tc");
+    }
+
+    return supported;
+}
+
+extern const void* load_dds(const char *filepath, struct dds_image *image)
+{
+    struct vfs_view file;
+
+    if(!vfs_open(filepath, &file))
+    {
+        memset(image, 0, sizeof(*image));
+        return NULL;
+    }
+
+    return load_dds_view(&file, image);
+}
+
+// Row r of a 4x4 block moves to row rows - 1 - r, the rows past the image stay put
+static void flip_block(uint32_t fourcc, const uint8_t *src, uint8_t *dst, int rows)
+{
+    const size_t block_size = fourcc == DDS_FOURCC_DXT1 ? 8 : 16;
+
+    memcpy(dst, src, block_size);
+
+    if(fourcc == DDS_FOURCC_DXT5)
+    {
+        // 3 bit alpha indices, 12 bits a row after the two endpoints
+        uint64_t indices = 0;
+
+        for(int i = 0; i < 6; i++)
+            indices |= (uint64_t)src[2 + i] << (8 * i);
+
+        uint64_t flipped = indices;
+
+        for(int r = 0; r < rows; r++)
+        {
+            flipped &= ~((uint64_t)0xfff << (12 * (rows - 1 - r)));
+            flipped |= ((indices >> (12 * r)) & 0xfff) << (12 * (rows - 1 - r));
+        }
+
+        for(int i = 0; i < 6; i++)
+            dst[2 + i] = (uint8_t)(flipped >> (8 * i));
+
+        src += 8;
+        dst += 8;
+    }
+
+    // 2 bit colour indices, a byte a row after the two endpoints
+    for(int r = 0; r < rows; r++)
+        dst[4 + rows - 1 - r] = src[4 + r];
+}
+
+// DDS stores the top block row first, GL wants the bottom one
+static void flip_level(uint32_t fourcc, const uint8_t *src, uint8_t *dst, GLsizei width, GLsizei height)
+{
+    const size_t block_size = fourcc == DDS_FOURCC_DXT1 ? 8 : 16;
+    const size_t row_size = (size_t)((width + 3) / 4) * block_size;
+    const int block_rows = (height + 3) / 4;
+    const int rows = height < 4 ? height : 4;
+
+    for(int y = 0; y < block_rows; y++)
+    {
+        const uint8_t *src_row = src + (size_t)(block_rows - 1 - y) * row_size;
+        uint8_t *dst_row = dst + (size_t)y * row_size;
+
+        for(size_t x = 0; x < row_size; x += block_size)
+            flip_block(fourcc, src_row + x, dst_row + x, rows);
+    }
+}
+
+extern const void* load_dds_view(struct vfs_view *file, struct dds_image *image)
+{
+    struct vfs_view view = *file;
+
+    memset(image, 0, sizeof(*image));
+    memset(file, 0, sizeof(*file));
+
+    const uint8_t *data = (const uint8_t*)view.data;
+    const size_t length = view.size;
+    struct dds_header header;
+
+    if(length < sizeof(header))
+    {
+        vfs_close(&view);
+        return NULL;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if((header.magic != DDS_MAGIC) || (header.size != sizeof(header) - sizeof(header.magic)) || !(header.format.flags & DDPF_FOURCC))
+    {
+        vfs_close(&view);
+        return NULL;
+    }
+
+    switch(header.format.fourcc)
+    {
+    case DDS_FOURCC_DXT1:
+        image->iformat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        break;
+    case DDS_FOURCC_DXT5:
+        image->iformat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    default:
+        vfs_close(&view);
+        return NULL;
+    }
+
+    image->width = header.width;
+    image->height = header.height;
+    image->levels = (header.flags & DDSD_MIPMAPCOUNT) && header.levels ? header.levels : 1;
+
+    if(image->levels > DDS_MAX_LEVELS)
+        image->levels = DDS_MAX_LEVELS;
+
+    size_t offset = sizeof(header);
+    GLsizei w = image->width, h = image->height;
+
+    for(int level = 0; level < image->levels; level++)
+    {
+        const size_t size = dds_level_size(header.format.fourcc, w, h);
+
+        // a partial block row can't be flipped without encoding the blocks again
+        if((size > length - offset) || ((h > 4) && (h % 4)))
+        {
+            vfs_close(&view);
+            free_dds(image);
+            return NULL;
+        }
+
+        image->sizes[level] = (GLsizei)size;
+        offset += size;
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    image->data = (uint8_t*)malloc(offset - sizeof(header));
+
+    if(!image->data)
+    {
+        vfs_close(&view);
+        free_dds(image);
+        return NULL;
+    }
+
+    uint8_t *blocks = image->data;
+
+    offset = sizeof(header);
+    w = image->width;
+    h = image->height;
+
+    for(int level = 0; level < image->levels; level++)
+    {
+        flip_level(header.format.fourcc, data + offset, blocks, w, h);
+
+        image->blocks[level] = blocks;
+        blocks += image->sizes[level];
+        offset += image->sizes[level];
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    vfs_close(&view);
+
+    return image->data;
+}
+
+extern void free_dds(struct dds_image *image)
+{
+    free(image->data);
+    memset(image, 0, sizeof(*image));
+}
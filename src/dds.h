@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glcore_450.h>
+#include "vfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DDS_MAX_LEVELS 16
+
+#define DDS_MAGIC 0x20534444        // "DDS "
+#define DDS_FOURCC_DXT1 0x31545844  // "DXT1"
+#define DDS_FOURCC_DXT5 0x35545844  // "DXT5"
+
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+
+struct dds_pixel_format
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourcc;
+    uint32_t    rgb_bit_count;
+    uint32_t    masks[4];
+};
+
+struct dds_header
+{
+    uint32_t    magic;
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    height;
+    uint32_t    width;
+    uint32_t    linear_size;
+    uint32_t    depth;
+    uint32_t    levels;
+    uint32_t    reserved1[11];
+    struct dds_pixel_format format;
+    uint32_t    caps[4];
+    uint32_t    reserved2;
+};
+
+// Files keep the top block row first like any DDS, the loaded blocks are flipped to GL
+// order, the first block row is the bottom of the image
+struct dds_image
+{
+    GLenum      iformat;
+    GLsizei     width;
+    GLsizei     height;
+    int         levels;
+
+    const uint8_t *blocks[DDS_MAX_LEVELS];
+    GLsizei     sizes[DDS_MAX_LEVELS];
+
+    uint8_t    *data;           // the flipped levels, blocks point into it
+};
+
+size_t dds_level_size(uint32_t fourcc, GLsizei width, GLsizei height);
+
+// Whether the current context takes the DXT1 and DXT5 formats of the images, core GL
+// doesn't have them without GL_EXT_texture_compression_s3tc. Only asked the first time.
+int dds_supported(void);
+
+const void* load_dds(const char *filepath, struct dds_image *image);
+// Same for a file already open, the view is closed either way. Fails when a level
+// taller than a block isn't a whole number of blocks tall.
+const void* load_dds_view(struct vfs_view *file, struct dds_image *image);
+void free_dds(struct dds_image *image);
+
+#ifdef __cplusplus
+}
+#endif
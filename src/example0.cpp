@@ -65,8 +65,8 @@ EXAMPLE_CALL void on_present(int w, int h, float alpha) {
     glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
     // Setup viewport 0
     glViewportIndexedf(0, 0, 0, (float)w, (float)h);
-    // Clear color buffer of current framebuffer(0)
-    glClearNamedFramebufferfv(0, GL_COLOR, 0, clear_color);
+    // Clear color buffer of the bound draw framebuffer
+    glClearBufferfv(GL_COLOR, 0, clear_color);
 
     glDrawArrays(GL_TRIANGLES, 0, 3);
 }
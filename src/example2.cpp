@@ -5,14 +5,16 @@
 #include <SDL2/SDL_events.h>
 #include <glcore_450.h>
 #include <cstddef>
+#include <cstring>
+#include <algorithm>
 #include "common.h"
 
 #define EXAMPLE_CALL extern "C"
 
 extern volatile int quit;
 
-extern "C" void* load_targa(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height);
-
+#include "texture_loader.h"
+#include "dds.h"
 #include "cube.h"
 
 const char* vertex_shader =
@@ -67,6 +69,23 @@ GLuint sampler;
 GLint loc_mvp;      // "world" matrix uniform location
 GLint loc_color;    // "color" uniform location
 
+static void upload_texture(int index, struct targa_image *image, void *userdata) {
+    UNUSED(index), UNUSED(userdata);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex_color);
+    glTextureStorage2D(tex_color, 4, image->iformat, image->width, image->height);
+    glTextureSubImage2D(tex_color, 0, 0, 0, image->width, image->height, image->format, GL_UNSIGNED_BYTE, image->pixels);
+    glGenerateTextureMipmap(tex_color);
+}
+
+static int upload_band(const struct targa_image *image, int y, int rows, const void *pixels, void *userdata) {
+    UNUSED(userdata);
+
+    glTextureSubImage2D(tex_color, 0, 0, y, image->width, rows, image->format, GL_UNSIGNED_BYTE, pixels);
+
+    return 1;
+}
+
 EXAMPLE_CALL void on_init(int w, int h, int vsync) {
     UNUSED(w), UNUSED(h), UNUSED(vsync);
 
@@ -80,20 +99,57 @@ EXAMPLE_CALL void on_init(int w, int h, int vsync) {
     glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
-    // Load texture
-    GLuint iformat;
-    GLenum format;
-    GLsizei tw;
-    GLsizei th;
+    // Load texture, from the packed assets when they were built
+    vfs_mount("assets.pak", "../");
 
-    void *pixels = load_targa("../textures/texture_01.tga", &iformat, &format, &tw, &th);
+    // BCn blocks written by texcompress are preferred
+    struct dds_image compressed;
 
-    glCreateTextures(GL_TEXTURE_2D, 1, &tex_color);
-    glTextureStorage2D(tex_color, 4, iformat, tw, th);
-    glTextureSubImage2D(tex_color, 0, 0, 0, tw, th, format, GL_UNSIGNED_BYTE, pixels);
-    glGenerateTextureMipmap(tex_color);
+    if (dds_supported() && load_dds("../textures/texture_01.dds", &compressed)) {
+        glCreateTextures(GL_TEXTURE_2D, 1, &tex_color);
+        glTextureStorage2D(tex_color, compressed.levels, compressed.iformat, compressed.width, compressed.height);
+
+        size_t compressed_size = 0, uncompressed_size = 0;
+
+        for (int level = 0; level < compressed.levels; level++) {
+            const GLsizei w = std::max(compressed.width >> level, 1), h = std::max(compressed.height >> level, 1);
+
+            glCompressedTextureSubImage2D(tex_color, level, 0, 0, w, h, compressed.iformat, compressed.sizes[level], compressed.blocks[level]);
 
-    free(pixels);
+            compressed_size += compressed.sizes[level];
+            uncompressed_size += (size_t)w * h * 4; // drivers pad RGB8 to 4 bytes
+        }
+
+        printf("Texture: %zu KiB of compressed blocks instead of %zu KiB, %zu KiB of VRAM saved\n",
+               compressed_size / 1024, uncompressed_size / 1024, (uncompressed_size - compressed_size) / 1024);
+
+        free_dds(&compressed);
+    } else {
+        const char *names[] = {"../textures/texture_01.tga"};
+        const size_t staging_size = 4 << 20;
+        struct targa_image info;
+
+        if (info_targa(names[0], &info) > staging_size) {
+            // Too large for the ring, decoded and uploaded 256 rows at a time
+            glCreateTextures(GL_TEXTURE_2D, 1, &tex_color);
+            glTextureStorage2D(tex_color, 4, info.iformat, info.width, info.height);
+            stream_targa(names[0], 256, upload_band, NULL);
+            glGenerateTextureMipmap(tex_color);
+        } else {
+            // Otherwise decode it straight into mapped pixel unpack memory, or
+            // into memory of its own when that can't be mapped
+            struct staging_buffer staging;
+
+            if (staging_buffer_init(&staging, staging_size)) {
+                load_targa_staged(&staging, names, 1, TEXTURE_LOADER_RGBA8, upload_texture, NULL);
+                staging_buffer_free(&staging);
+            } else {
+                load_targa_parallel(names, 1, TEXTURE_LOADER_RGBA8, upload_texture, NULL);
+            }
+        }
+    }
+
+    vfs_unmount();
 
     // Create VBO
     glCreateBuffers(1, &vbo);
@@ -177,18 +233,46 @@ EXAMPLE_CALL void on_cleanup(void) {
     glDeleteProgramPipelines(1, &pipeline);
 }
 
-static float current_angle = 0;
-static float previous_angle = 0;
+// on_update may run on a thread of its own, on_present draws from a copy
+struct State {
+    float current_angle;
+    float previous_angle;
+};
+
+static State simulated = {0, 0};
+static State presented = {0, 0};
+
+EXAMPLE_CALL size_t on_state_size(void) {
+    return sizeof(State);
+}
+
+EXAMPLE_CALL void on_save_state(void *state) {
+    memcpy(state, &simulated, sizeof(State));
+}
+
+EXAMPLE_CALL void on_load_state(const void *state) {
+    memcpy(&presented, state, sizeof(State));
+}
 
 EXAMPLE_CALL void on_update(float dt) {
-    previous_angle = current_angle;
-    current_angle += 0.5f * dt;
+    simulated.previous_angle = simulated.current_angle;
+    simulated.current_angle += 0.5f * dt;
+}
+
+EXAMPLE_CALL void on_update_n(unsigned int steps, float dt) {
+    // steps - 1 would wrap, and no step leaves both angles as they were
+    if (!steps)
+        return;
+
+    // The spin is linear, so the steps add up in closed form
+    simulated.previous_angle = simulated.current_angle + 0.5f * dt * (steps - 1);
+    simulated.current_angle += 0.5f * dt * steps;
 }
 
 EXAMPLE_CALL void on_present(int w, int h, float alpha) {
     using namespace glm;
 
-    float angle = mix(previous_angle, current_angle, alpha);
+    float angle = mix(presented.previous_angle, presented.current_angle, alpha);
 
     mat4 model = translate(mat4(1.f), vec3(0, 0, 0));
     model = rotate(model, angle, vec3(1, 0, 0));
@@ -207,10 +291,10 @@ EXAMPLE_CALL void on_present(int w, int h, float alpha) {
     glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
     // Setup viewport 0
     glViewportIndexedf(0, 0, 0, (float)w, (float)h);
-    // Clear color buffer of current framebuffer(0)
-    glClearNamedFramebufferfv(0, GL_COLOR, 0, clear_color);
-    // Clear depth buffer of current framebuffer(0)
-    glClearNamedFramebufferfv(0, GL_DEPTH, 0, &clear_depth);
+    // Clear color buffer of the bound draw framebuffer
+    glClearBufferfv(GL_COLOR, 0, clear_color);
+    // Clear depth buffer of the bound draw framebuffer
+    glClearBufferfv(GL_DEPTH, 0, &clear_depth);
 
     glEnable(GL_DEPTH_TEST);
 
@@ -3,23 +3,37 @@
  * autor: Michael Poddubnyi (c) 2015
  */
 #include <SDL2/SDL_events.h>
+#include <SDL2/SDL_timer.h>
 #include <glcore_450.h>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include "common.h"
 
 #define EXAMPLE_CALL extern "C"
 
 extern volatile int quit;
-
-extern "C" void* load_targa(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height);
-
+extern int frame_slots;
+extern int frame_slot;
+extern const char *texture_loader;
+
+EXAMPLE_CALL void latch_input(void);
+
+#include "texture_array.h"
+#include "texture_stream.h"
+#include "texture_pool.h"
+#include "pixel_convert.h"
+#include "mipmap.h"
+#include "dds.h"
 #include "cube.h"
 
 struct Material {
     glm::vec4   color;
+    float       scale[2];       // of the texture coordinates, for images smaller than their layer
     float       layer;
-    float       padding[3];
+    float       padding;
 };
 
 const char* vertex_shader =
@@ -30,6 +44,8 @@ const char* vertex_shader =
         "layout(location = 1) in vec2 texcoord;"
         "layout(location = 2) in vec3 normal;"
 
+        "uniform int first_instance;"
+
         "layout (std140) uniform MatrixBlock {"
         "mat4 projection_view;"
         "mat4 model[MAX_INSTANCES];"
@@ -46,10 +62,11 @@ const char* vertex_shader =
         "} vs_output;"
 
         "void main () {"
+        "  int instance = first_instance + gl_InstanceID;"
         "  vs_output.texcoord = texcoord;"
-        "  vs_output.normal = vec3(model[gl_InstanceID] * vec4(normal, 0));"
-        "  vs_output.index = gl_InstanceID;"
-        "  gl_Position = projection_view * model[gl_InstanceID] * vec4(position, 1.0);"
+        "  vs_output.normal = vec3(model[instance] * vec4(normal, 0));"
+        "  vs_output.index = instance;"
+        "  gl_Position = projection_view * model[instance] * vec4(position, 1.0);"
         "}";
 
 const char* fragment_shader =
@@ -61,6 +78,7 @@ const char* fragment_shader =
 
         "struct Material {"
         "vec4 color;"
+        "vec2 scale;"
         "float layer;"
         "};"
 
@@ -77,10 +95,10 @@ const char* fragment_shader =
         "layout (location = 0, index = 0) out vec4 frag_color;"
         "void main () {"
         "  vec3 n = normalize(fs_input.normal);"
-        "  frag_color = materials[fs_input.index].color * texture(tex, vec3(fs_input.texcoord, materials[fs_input.index].layer));"
+        "  frag_color = materials[fs_input.index].color * texture(tex, vec3(fs_input.texcoord * materials[fs_input.index].scale, materials[fs_input.index].layer));"
         "}";
 
-GLuint ubo;         // uniform buffer for matrices
+GLuint ubo;         // uniform buffer for matrices, a version per frame slot
 GLuint ubo2;        // uniform buffer for materials
 GLuint vbo;         // vertex buffer
 GLuint ebo;         // element buffer
@@ -91,37 +109,322 @@ GLuint fs;          // fragment program
 
 GLuint sampler;
 GLint loc_color;    // "color" uniform location
+GLint loc_first;    // "first_instance" uniform location
 GLuint tex_array;
 
-static void init_textures() {
-    const int base_w = 512;
-    const int base_h = 512;
+// The matrices are written straight into the slot of the frame, the frame fences
+// keep the GPU from still reading it
+static const GLbitfield ubo_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+static char *ubo_memory;
+static GLsizeiptr ubo_stride;   // matrices of a slot, rounded to the offset alignment
+
+// Expand BGR to RGBA on the CPU, so the driver copies its native layout straight through
+static const bool textures_rgba8 = true;
+
+// Ways of loading the textures, -textures picks one
+enum TextureLoader {
+    TEXTURES_DEFAULT,   // the BCn blocks when texcompress wrote them, the array otherwise
+    TEXTURES_DDS,       // BCn blocks, the array when they are missing
+    TEXTURES_ARRAY,     // mip chains from the cache into one array up front
+    TEXTURES_STREAM,    // placeholders, the mip chains arrive over the first frames
+    TEXTURES_POOL,      // a layer of the pool per texture, whatever its size
+};
+
+// Orbit of the camera, dragged with the left mouse button. Events are handled on the
+// main thread while on_present may run on the render thread.
+static std::atomic<float> camera_yaw(0.f);
+static std::atomic<float> camera_pitch(0.f);
+
+#define TEXTURE_STREAM_BUDGET (1 << 20)     // bytes uploaded per frame
+
+static struct texture_stream *stream;
+static Uint64 stream_start;
+
+#define TEXTURE_POOL_LAYERS 64                  // per array of a size class
+
+static struct texture_pool pool;
+
+// The layer each material samples, filled by init_textures
+static struct texture_handle texture_handles[6];
+
+// Instances sharing an array are drawn together, one bind and draw per array
+struct DrawBatch {
+    GLuint      texture;
+    int         first;
+    int         count;
+};
+
+static DrawBatch batches[6];
+static int batches_count;
+static int draw_order[6];       // instance to cube, sorted by array
+
+static void array_handles(GLuint texture) {
+    for (int i = 0; i < 6; i++) {
+        texture_handles[i] = {};
+        texture_handles[i].texture = texture;
+        texture_handles[i].layer = i;
+        texture_handles[i].width = 512;
+        texture_handles[i].height = 512;
+        texture_handles[i].scale[0] = 1.f;
+        texture_handles[i].scale[1] = 1.f;
+    }
+}
+
+static void init_batches() {
+    batches_count = 0;
+
+    for (int i = 0; i < 6; i++) {
+        int b = 0;
+
+        while (b < batches_count && batches[b].texture != texture_handles[i].texture)
+            b++;
+
+        if (b == batches_count)
+            batches[batches_count++] = {texture_handles[i].texture, 0, 0};
+
+        batches[b].count++;
+    }
+
+    for (int b = 1; b < batches_count; b++)
+        batches[b].first = batches[b - 1].first + batches[b - 1].count;
 
+    int filled[6] = {};
+
+    for (int i = 0; i < 6; i++) {
+        int b = 0;
+
+        while (batches[b].texture != texture_handles[i].texture)
+            b++;
+
+        draw_order[batches[b].first + filled[b]++] = i;
+    }
+}
+
+// Uses the BCn blocks written by texcompress when they exist for every layer and the
+// context takes them
+static bool init_compressed_textures() {
     const char *names[] = {
-        "../textures/brick_guiGen_512_d.tga",
-        "../textures/FloorBrick_JFCartoonyFloorBrickDirty_512_d.tga",
-        "../textures/Ground_MossyDirt_512_d.tga",
-        "../textures/Metal_SciFiDiamondPlate_512_d.tga",
-        "../textures/Misc_OakbarrelOld_512_d.tga",
-        "../textures/rock_guiWallSmooth09_512_d.tga"
+        "../textures/brick_guiGen_512_d.dds",
+        "../textures/FloorBrick_JFCartoonyFloorBrickDirty_512_d.dds",
+        "../textures/Ground_MossyDirt_512_d.dds",
+        "../textures/Metal_SciFiDiamondPlate_512_d.dds",
+        "../textures/Misc_OakbarrelOld_512_d.dds",
+        "../textures/rock_guiWallSmooth09_512_d.dds"
     };
 
-    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &tex_array);
-    glTextureStorage3D(tex_array, 4, GL_RGB8, base_w, base_h, 6);
+    struct dds_image images[6] = {};
+    struct texture_layer layers[6] = {};
+    struct vfs_view files[6];
+    bool loaded = true;
+
+    if (!dds_supported())
+        return false;
+
+    // All six reads go out together instead of one blocking read after another
+    vfs_open_batch(names, 6, files, 0);
 
     for (int i = 0; i < 6; i++) {
-        GLuint iformat;
-        GLenum format;
-        GLsizei tw;
-        GLsizei th;
+        // every view is handed over, even after a layer failed
+        bool valid = load_dds_view(&files[i], &images[i]) != NULL;
+
+        loaded = loaded && valid && (images[i].iformat == images[0].iformat) &&
+                (images[i].width == 512) && (images[i].height == 512) && (images[i].levels == images[0].levels);
+
+        for (int level = 0; level < images[i].levels; level++) {
+            layers[i].pixels[level] = images[i].blocks[level];
+            layers[i].sizes[level] = images[i].sizes[level];
+        }
+    }
+
+    if (loaded) {
+        struct texture_array_desc desc = {};
 
-        void *pixels = load_targa(names[i], &iformat, &format, &tw, &th);
+        desc.iformat = images[0].iformat;
+        desc.width = 512;
+        desc.height = 512;
+        desc.levels = images[0].levels;
+        desc.compressed = 1;
+        desc.layers = layers;
+        desc.layers_count = 6;
 
-        glTextureSubImage3D(tex_array, 0, 0, 0, i, tw, th, 1, format, GL_UNSIGNED_BYTE, pixels);
-        glGenerateTextureMipmap(tex_array);
+        tex_array = create_texture_array(&desc);
+        array_handles(tex_array);
 
-        free(pixels);
+        size_t compressed_size = 0, uncompressed_size = 0;
+
+        for (int level = 0; level < images[0].levels; level++) {
+            compressed_size += images[0].sizes[level] * 6;
+            uncompressed_size += (size_t)(512 >> level) * (512 >> level) * 4 * 6; // drivers pad RGB8 to 4 bytes
+        }
+
+        printf("Texture array: %zu KiB of compressed blocks instead of %zu KiB, %zu KiB of VRAM saved\n",
+               compressed_size / 1024, uncompressed_size / 1024, (uncompressed_size - compressed_size) / 1024);
     }
+
+    for (int i = 0; i < 6; i++)
+        free_dds(&images[i]);
+
+    return loaded;
+}
+
+static const char *texture_names[] = {
+    "../textures/brick_guiGen_512_d.tga",
+    "../textures/FloorBrick_JFCartoonyFloorBrickDirty_512_d.tga",
+    "../textures/Ground_MossyDirt_512_d.tga",
+    "../textures/Metal_SciFiDiamondPlate_512_d.tga",
+    "../textures/Misc_OakbarrelOld_512_d.tga",
+    "../textures/rock_guiWallSmooth09_512_d.tga"
+};
+
+// Each texture gets a layer of its size class whatever its size, a file that can't
+// be loaded keeps an empty handle and samples black
+static void init_pooled_textures(const struct mip_chain *chains, GLenum iformat) {
+    texture_pool_init(&pool, TEXTURE_POOL_LAYERS);
+
+    size_t largest = 0;
+
+    for (int i = 0; i < 6; i++)
+        if ((size_t)chains[i].width * chains[i].height > largest)
+            largest = (size_t)chains[i].width * chains[i].height;
+
+    void *converted = textures_rgba8 ? malloc(largest * 4) : NULL;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (int i = 0; i < 6; i++) {
+        struct texture_handle *handle = &texture_handles[i];
+
+        if (!chains[i].levels || !texture_pool_alloc(&pool, iformat, chains[i].width, chains[i].height, handle))
+            continue;
+
+        GLsizei w = chains[i].width, h = chains[i].height;
+
+        for (int level = 0; level < chains[i].levels; level++) {
+            const void *pixels = chains[i].pixels[level];
+            GLenum format = chains[i].format;
+
+            if (converted && convert_to_rgba8(pixels, converted, (size_t)w * h, format)) {
+                pixels = converted;
+                format = GL_RGBA;
+            }
+
+            glTextureSubImage3D(handle->texture, level, 0, 0, handle->layer, w, h, 1, format, GL_UNSIGNED_BYTE, pixels);
+
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+        }
+
+        // a smaller image than its class fills the rest of the layer with its edges
+        texture_pool_pad(&pool, handle, chains[i].levels);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    free(converted);
+}
+
+static TextureLoader selected_loader() {
+    static const char *names[] = {"dds", "array", "stream", "pool"};
+
+    if (!texture_loader)
+        return TEXTURES_DEFAULT;
+
+    for (int i = 0; i < 4; i++)
+        if (!strcmp(texture_loader, names[i]))
+            return (TextureLoader)(TEXTURES_DDS + i);
+
+    printf("Unknown texture loader %s\n", texture_loader);
+
+    return TEXTURES_DEFAULT;
+}
+
+static void init_textures() {
+    Uint64 start = SDL_GetPerformanceCounter();
+    TextureLoader loader = selected_loader();
+
+    if (((loader == TEXTURES_DEFAULT) || (loader == TEXTURES_DDS)) && init_compressed_textures()) {
+        glFinish();
+
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        printf("Texture array created in %.2f ms\n", (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+        return;
+    }
+
+    struct texture_layer layers[6] = {};
+    struct texture_array_desc desc = {};
+
+    for (int i = 0; i < 6; i++)
+        layers[i].filepath = texture_names[i];
+
+    desc.iformat = textures_rgba8 ? GL_RGBA8 : GL_RGB8;
+    desc.format = GL_BGR;
+    desc.rgba8 = textures_rgba8;
+    desc.width = 512;
+    desc.height = 512;
+    desc.levels = mip_levels_count(512, 512);
+    desc.layers = layers;
+    desc.layers_count = 6;
+
+    if (loader == TEXTURES_DDS)
+        printf("No compressed textures, loading the TGA files into an array\n");
+
+    if (loader == TEXTURES_STREAM) {
+        // Placeholders now, the real levels arrive over the next frames
+        stream = create_texture_stream(&desc, 1, &tex_array);
+        array_handles(tex_array);
+        stream_start = start;
+        glFinish();
+
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        printf("Texture array placeholders created in %.2f ms\n", (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+        return;
+    }
+
+    // Full mip chains come from the cache next to each TGA, a layer without
+    // one is decoded from the file and mipmapped on the GPU instead
+    struct mip_chain chains[6];
+
+    load_mip_chains(texture_names, 6, MIP_MAX_LEVELS, 1, chains);
+
+    if (loader == TEXTURES_POOL) {
+        init_pooled_textures(chains, desc.iformat);
+        glFinish();
+
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        printf("Texture pool filled in %.2f ms\n", (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+        for (int i = 0; i < 6; i++)
+            free_mip_chain(&chains[i]);
+
+        return;
+    }
+
+    for (int i = 0; i < 6; i++)
+        for (int level = 0; level < chains[i].levels; level++)
+            layers[i].pixels[level] = chains[i].pixels[level];
+
+    struct staging_buffer staging;
+
+    // the files are mapped instead when the ring can't be
+    desc.staging = staging_buffer_init(&staging, 8 << 20) ? &staging : NULL;
+
+    tex_array = create_texture_array(&desc);
+    array_handles(tex_array);
+    glFinish();
+
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    printf("Texture array created in %.2f ms\n", (double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+    staging_buffer_free(&staging);
+
+    for (int i = 0; i < 6; i++)
+        free_mip_chain(&chains[i]);
 }
 
 EXAMPLE_CALL void on_init(int w, int h, int vsync) {
@@ -137,23 +440,45 @@ EXAMPLE_CALL void on_init(int w, int h, int vsync) {
     glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
-    // Load textures
+    // Load textures, from the packed assets when they were built. The archive stays
+    // mounted while textures stream in.
+    vfs_mount("assets.pak", "../");
     init_textures();
+    init_batches();
 
     // Creeate UBO for matrices
     glCreateBuffers(1, &ubo);
-    // Allocate memory for data
-    glNamedBufferData(ubo, sizeof(glm::mat4) * 7, NULL, GL_STREAM_DRAW);
-
-    Material materials[6] = {
-        {glm::vec4(1, 0, 0, 1), 0, {0}},
-        {glm::vec4(0, 1, 0, 1), 1, {0}},
-        {glm::vec4(0, 0, 1, 1), 2, {0}},
-        {glm::vec4(1, 1, 0, 1), 3, {0}},
-        {glm::vec4(1, 0, 1, 1), 4, {0}},
-        {glm::vec4(0, 1, 1, 1), 5, {0}},
+
+    GLint ubo_alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment);
+    ubo_stride = (sizeof(glm::mat4) * 7 + ubo_alignment - 1) / ubo_alignment * ubo_alignment;
+
+    // Allocate memory for data and map it for good
+    glNamedBufferStorage(ubo, ubo_stride * frame_slots, NULL, ubo_flags);
+    ubo_memory = (char*)glMapNamedBufferRange(ubo, 0, ubo_stride * frame_slots, ubo_flags);
+
+    glm::vec4 colors[6] = {
+        glm::vec4(1, 0, 0, 1),
+        glm::vec4(0, 1, 0, 1),
+        glm::vec4(0, 0, 1, 1),
+        glm::vec4(1, 1, 0, 1),
+        glm::vec4(1, 0, 1, 1),
+        glm::vec4(0, 1, 1, 1),
     };
 
+    // Materials in draw order, each with the layer of its texture
+    Material materials[6];
+
+    for (int i = 0; i < 6; i++) {
+        const struct texture_handle *handle = &texture_handles[draw_order[i]];
+
+        materials[i].color = colors[draw_order[i]];
+        materials[i].layer = (float)handle->layer;
+        materials[i].scale[0] = handle->scale[0];
+        materials[i].scale[1] = handle->scale[1];
+        materials[i].padding = 0;
+    }
+
     // Create UBO for materials
     glCreateBuffers(1, &ubo2);
     // Allocate memory for data and send it
@@ -218,6 +543,7 @@ EXAMPLE_CALL void on_init(int w, int h, int vsync) {
 
     // Get programs uniform locations
     loc_color = glGetUniformLocation(fs, "color");
+    loc_first = glGetUniformLocation(vs, "first_instance");
 
     // Bind ubo
     int block_index = glGetUniformBlockIndex(vs, "MatrixBlock");
@@ -236,34 +562,82 @@ EXAMPLE_CALL void on_quit(void) {
 }
 
 EXAMPLE_CALL void on_cleanup(void) {
+    free_texture_stream(stream);
+    vfs_unmount();
+
     // Delete all resources
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &ebo);
+    glUnmapNamedBuffer(ubo);
     glDeleteBuffers(1, &ubo);
     glDeleteBuffers(1, &ubo2);
     glDeleteVertexArrays(1, &vao);
     glDeleteTextures(1, &tex_array);
+    texture_pool_free(&pool);
     glDeleteSamplers(1, &sampler);
     glDeleteProgram(vs);
     glDeleteProgram(fs);
     glDeleteProgramPipelines(1, &pipeline);
 }
 
-static float current_angle = 0;
-static float previous_angle = 0;
+// on_update may run on a thread of its own, on_present draws from a copy
+struct State {
+    float current_angle;
+    float previous_angle;
+};
+
+static State simulated = {0, 0};
+static State presented = {0, 0};
+
+EXAMPLE_CALL size_t on_state_size(void) {
+    return sizeof(State);
+}
+
+EXAMPLE_CALL void on_save_state(void *state) {
+    memcpy(state, &simulated, sizeof(State));
+}
+
+EXAMPLE_CALL void on_load_state(const void *state) {
+    memcpy(&presented, state, sizeof(State));
+}
 
 EXAMPLE_CALL void on_update(float dt) {
-    previous_angle = current_angle;
-    current_angle += 0.5f * dt;
+    simulated.previous_angle = simulated.current_angle;
+    simulated.current_angle += 0.5f * dt;
+}
+
+EXAMPLE_CALL void on_update_n(unsigned int steps, float dt) {
+    // steps - 1 would wrap, and no step leaves both angles as they were
+    if (!steps)
+        return;
+
+    // The spin is linear, so the steps add up in closed form
+    simulated.previous_angle = simulated.current_angle + 0.5f * dt * (steps - 1);
+    simulated.current_angle += 0.5f * dt * steps;
 }
 
 EXAMPLE_CALL void on_present(int w, int h, float alpha) {
     using namespace glm;
 
-    float angle = mix(previous_angle, current_angle, alpha);
+    float angle = mix(presented.previous_angle, presented.current_angle, alpha);
+
+    if (stream && update_texture_stream(stream, TEXTURE_STREAM_BUDGET)) {
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        printf("Texture array fully resident %.2f ms after init\n", (double)(end - stream_start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+        free_texture_stream(stream);
+        stream = NULL;
+    }
 
     mat4 projection = perspective(45.f, (float)w/(float)h, 1.f, 100.f);
+
+    // The newest input, read as late as the frame allows
+    latch_input();
+
     mat4 view = translate(mat4(1.f), vec3(0, 0, -10.f));
+    view = rotate(view, camera_pitch.load(), vec3(1, 0, 0));
+    view = rotate(view, camera_yaw.load(), vec3(0, 1, 0));
     mat4 pvm = projection * view;
 
     float clear_color[4] = {0.4, 0.4, 0.4, 1};
@@ -279,46 +653,55 @@ EXAMPLE_CALL void on_present(int w, int h, float alpha) {
         {-1,  0, -1},
     };
 
-    for (int i = 0; i < 6; i++) {
-        models[i] = translate(mat4(1.f), vec3((i % 2) * 4 - 1.5f, (i % 3) * 3 - 3.f, 0));
-        models[i] = rotate(models[i], angle * angles[i][0], vec3(1, 0, 0));
-        models[i] = rotate(models[i], angle * angles[i][1], vec3(0, 1, 0));
-        models[i] = rotate(models[i], angle * angles[i][2], vec3(0, 0, 1));
-        models[i] = scale(models[i], vec3(1.f));
+    // Matrices in draw order, like the materials
+    for (int k = 0; k < 6; k++) {
+        int i = draw_order[k];
+
+        models[k] = translate(mat4(1.f), vec3((i % 2) * 4 - 1.5f, (i % 3) * 3 - 3.f, 0));
+        models[k] = rotate(models[k], angle * angles[i][0], vec3(1, 0, 0));
+        models[k] = rotate(models[k], angle * angles[i][1], vec3(0, 1, 0));
+        models[k] = rotate(models[k], angle * angles[i][2], vec3(0, 0, 1));
+        models[k] = scale(models[k], vec3(1.f));
     }
 
-    // Update ubo buffer with matrices
-    void *ptr = glMapNamedBufferRange(ubo, 0, sizeof (mat4) * 7, GL_MAP_WRITE_BIT);
-    memcpy((char*)ptr, &pvm[0][0], sizeof (mat4));
-    memcpy((char*)ptr + sizeof (mat4), models, sizeof (mat4) * 6);
-    glUnmapNamedBuffer(ubo);
+    // Update the matrices of this frame's slot
+    GLintptr ubo_offset = ubo_stride * frame_slot;
+    memcpy(ubo_memory + ubo_offset, &pvm[0][0], sizeof (mat4));
+    memcpy(ubo_memory + ubo_offset + sizeof (mat4), models, sizeof (mat4) * 6);
 
     // Clip window
     glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
     // Setup viewport 0
     glViewportIndexedf(0, 0, 0, (float)w, (float)h);
-    // Clear color buffer of current framebuffer(0)
-    glClearNamedFramebufferfv(0, GL_COLOR, 0, clear_color);
-    // Clear depth buffer of current framebuffer(0)
-    glClearNamedFramebufferfv(0, GL_DEPTH, 0, &clear_depth);
+    // Clear color buffer of the bound draw framebuffer
+    glClearBufferfv(GL_COLOR, 0, clear_color);
+    // Clear depth buffer of the bound draw framebuffer
+    glClearBufferfv(GL_DEPTH, 0, &clear_depth);
 
     glEnable(GL_DEPTH_TEST);
 
     glProgramUniform3f(fs, loc_color, 0.8, 0.9, 0.8);
 
     // Bind ubo
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, 0, sizeof (mat4) * 7);
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, ubo_offset, sizeof (mat4) * 7);
     glBindBufferRange(GL_UNIFORM_BUFFER, 1, ubo2, 0, sizeof (Material) * 6);
 
-    // Bind texture and sampler to unit 0
-    glBindTextureUnit(0, tex_array);
+    // Bind sampler to unit 0, then each array with the instances sampling it
     glBindSampler(0, sampler);
 
-    glDrawElementsInstanced(GL_TRIANGLES, CUBE_INDICES_NUM, GL_UNSIGNED_SHORT, NULL, 6);
+    for (int b = 0; b < batches_count; b++) {
+        glBindTextureUnit(0, batches[b].texture);
+        glProgramUniform1i(vs, loc_first, batches[b].first);
+
+        glDrawElementsInstanced(GL_TRIANGLES, CUBE_INDICES_NUM, GL_UNSIGNED_SHORT, NULL, batches[b].count);
+    }
 
     glDisable(GL_DEPTH_TEST);
 }
 
 EXAMPLE_CALL void on_event(SDL_Event *event) {
-    UNUSED(event);
+    if ((event->type == SDL_MOUSEMOTION) && (event->motion.state & SDL_BUTTON_LMASK)) {
+        camera_yaw.store(camera_yaw.load() + event->motion.xrel * 0.01f);
+        camera_pitch.store(camera_pitch.load() + event->motion.yrel * 0.01f);
+    }
 }
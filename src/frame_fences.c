@@ -0,0 +1,68 @@
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "frame_fences.h"
+
+#define FRAME_FENCES_TIMEOUT 1000000000ull // ns
+
+extern void frame_fences_init(struct frame_fences *fences, int count)
+{
+    memset(fences, 0, sizeof(*fences));
+
+    fences->count = count < 1 ? 1 : (count > FRAME_FENCES_MAX ? FRAME_FENCES_MAX : count);
+    fences->slot = fences->count - 1;
+}
+
+extern void frame_fences_free(struct frame_fences *fences)
+{
+    for(int i = 0; i < FRAME_FENCES_MAX; i++)
+    {
+        if(fences->fences[i])
+            glDeleteSync(fences->fences[i]);
+    }
+
+    memset(fences, 0, sizeof(*fences));
+}
+
+extern int frame_fences_begin(struct frame_fences *fences)
+{
+    fences->slot = (fences->slot + 1) % fences->count;
+    fences->frames++;
+
+    GLsync sync = fences->fences[fences->slot];
+
+    if(!sync)
+        return fences->slot;
+
+    // usually signalled already, only a real wait is timed
+    if(glClientWaitSync(sync, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        const Uint64 start = SDL_GetPerformanceCounter();
+
+        while(glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_FENCES_TIMEOUT) == GL_TIMEOUT_EXPIRED)
+            ;
+
+        fences->waits++;
+        fences->waited += (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    }
+
+    glDeleteSync(sync);
+    fences->fences[fences->slot] = NULL;
+
+    return fences->slot;
+}
+
+extern void frame_fences_end(struct frame_fences *fences)
+{
+    fences->fences[fences->slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+extern void frame_fences_report(const struct frame_fences *fences, FILE *fp)
+{
+    fprintf(fp, "Frames in flight: %d, %u of %u frames waited for a slot", fences->count, fences->waits, fences->frames);
+
+    if(fences->waits)
+        fprintf(fp, ", %.3f ms on average", fences->waited / fences->waits);
+
+    fprintf(fp, "\n");
+}
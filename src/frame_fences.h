@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdio.h>
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_FENCES_MAX 3
+
+// Bounds how many frames the driver may queue. Each frame ends with a fence in its
+// slot and the next use of the slot waits for it, so anything versioned per slot
+// can be rewritten without an implicit sync.
+struct frame_fences
+{
+    GLsync      fences[FRAME_FENCES_MAX];
+    int         count;          // frames in flight, 1 to FRAME_FENCES_MAX
+    int         slot;           // of the current frame
+
+    unsigned    frames;
+    unsigned    waits;          // frames whose slot was still in use
+    double      waited;         // ms
+};
+
+// Count is clamped to 1..FRAME_FENCES_MAX
+void frame_fences_init(struct frame_fences *fences, int count);
+void frame_fences_free(struct frame_fences *fences);
+
+// Waits until the GPU is done with the frame that last used the next slot, returns the slot
+int frame_fences_begin(struct frame_fences *fences);
+// Fences the commands of the frame, call after the swap
+void frame_fences_end(struct frame_fences *fences);
+
+void frame_fences_report(const struct frame_fences *fences, FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
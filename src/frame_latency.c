@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "frame_latency.h"
+#include "frame_limiter.h"
+
+// The shortest recent swap interval. A missed swap must not stretch the period, or
+// the next start aims at the vblank after the one it could have made and the loop
+// settles at half rate. Too short only starts early, which costs latency, not frames.
+static uint64_t predict_period(const struct frame_latency *latency)
+{
+    const unsigned count = latency->count < FRAME_LATENCY_HISTORY ? latency->count : FRAME_LATENCY_HISTORY;
+    uint64_t period = latency->intervals[0];
+
+    for(unsigned i = 1; i < count; i++)
+    {
+        if(latency->intervals[i] < period)
+            period = latency->intervals[i];
+    }
+
+    return period;
+}
+
+// The longest recent work, being early costs latency but being late costs a whole period
+static uint64_t predict_work(const struct frame_latency *latency)
+{
+    const unsigned count = latency->count < FRAME_LATENCY_HISTORY ? latency->count : FRAME_LATENCY_HISTORY;
+    uint64_t work = 0;
+
+    for(unsigned i = 0; i < count; i++)
+    {
+        if(latency->works[i] > work)
+            work = latency->works[i];
+    }
+
+    return work;
+}
+
+extern void frame_latency_init(struct frame_latency *latency, int jit, int margin_us)
+{
+    memset(latency, 0, sizeof(*latency));
+
+    latency->jit = jit;
+    latency->margin = (uint64_t)(margin_us > 0 ? margin_us : 0) * 1000u;
+    latency->slack = latency->margin;
+}
+
+extern void frame_latency_start(struct frame_latency *latency)
+{
+    uint64_t current = frame_limiter_now();
+
+    if(latency->jit && latency->swapped && latency->count)
+    {
+        const uint64_t start = latency->swapped + predict_period(latency) - predict_work(latency) - latency->slack;
+
+        if(start > current)
+        {
+            frame_limiter_sleep_until(start, (uint64_t)FRAME_LIMITER_SPIN_US * 1000u);
+
+            latency->delayed_sum += (double)(start - current) / 1e6;
+            current = frame_limiter_now();
+        }
+    }
+
+    latency->started = current;
+    latency->input = current;
+}
+
+extern void frame_latency_input(struct frame_latency *latency)
+{
+    latency->input = frame_limiter_now();
+}
+
+extern void frame_latency_submitted(struct frame_latency *latency)
+{
+    latency->submitted = frame_limiter_now();
+}
+
+extern void frame_latency_swapped(struct frame_latency *latency)
+{
+    const uint64_t current = frame_limiter_now();
+    const unsigned index = latency->count % FRAME_LATENCY_HISTORY;
+
+    if(latency->swapped)
+    {
+        const uint64_t interval = current - latency->swapped;
+
+        if(latency->count >= FRAME_LATENCY_HISTORY)
+        {
+            const uint64_t period = predict_period(latency);
+
+            // started too late, the next frames start earlier and creep back afterwards
+            if(interval >= period * 3 / 2)
+            {
+                latency->missed++;
+                latency->slack = latency->slack + latency->margin < period / 2 ? latency->slack + latency->margin : period / 2;
+            }
+            else if(latency->slack > latency->margin)
+                latency->slack -= latency->margin / 16 < latency->slack - latency->margin ? latency->margin / 16 : latency->slack - latency->margin;
+        }
+
+        latency->intervals[index] = interval;
+        latency->works[index] = latency->submitted - latency->started;
+        latency->count++;
+    }
+
+    const double ms = (double)(current - latency->input) / 1e6;
+
+    latency->frames++;
+    latency->latency_sum += ms;
+
+    if(ms > latency->latency_max)
+        latency->latency_max = ms;
+
+    latency->swapped = current;
+}
+
+extern void frame_latency_report(const struct frame_latency *latency, FILE *fp)
+{
+    if(!latency->frames)
+        return;
+
+    fprintf(fp, "Input to present (estimated): avg %.3f ms, max %.3f ms", latency->latency_sum / latency->frames, latency->latency_max);
+
+    if(latency->jit)
+        fprintf(fp, ", starts pushed back %.3f ms on average, %u missed swaps, %.3f ms slack", latency->delayed_sum / latency->frames,
+                latency->missed, (double)latency->slack / 1e6);
+
+    fprintf(fp, "\n");
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_LATENCY_HISTORY 16        // frames the estimates look back on
+#define FRAME_LATENCY_MARGIN_US 1000    // slack left between the predicted work and the swap
+
+// Estimates input-to-present latency from the time input was last read to the
+// time the swap returned. In just-in-time mode the frame start is pushed back to
+// the predicted next swap minus the longest recent CPU work and a slack, so a swap
+// that blocks for the display waits before the input is read rather than after.
+// GPU time only shows as missed swaps, each of which grows the slack.
+struct frame_latency
+{
+    int         jit;
+    uint64_t    margin;         // ns
+    uint64_t    slack;          // ns, the margin plus what missed swaps added
+
+    uint64_t    intervals[FRAME_LATENCY_HISTORY];   // ns between swaps
+    uint64_t    works[FRAME_LATENCY_HISTORY];       // ns from frame start to the swap call
+    unsigned    count;
+
+    uint64_t    started;        // of the current frame
+    uint64_t    submitted;      // swap called
+    uint64_t    input;          // input last read
+    uint64_t    swapped;        // previous swap returned
+
+    unsigned    frames;
+    double      latency_sum;    // ms
+    double      latency_max;
+    double      delayed_sum;    // ms the starts were pushed back
+    unsigned    missed;         // swaps a period or more later than predicted
+};
+
+void frame_latency_init(struct frame_latency *latency, int jit, int margin_us);
+
+// Call at the top of the frame, right before the events are polled
+void frame_latency_start(struct frame_latency *latency);
+// Input was read again during the frame
+void frame_latency_input(struct frame_latency *latency);
+// Call right before the swap and right after it returned
+void frame_latency_submitted(struct frame_latency *latency);
+void frame_latency_swapped(struct frame_latency *latency);
+
+void frame_latency_report(const struct frame_latency *latency, FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
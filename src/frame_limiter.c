@@ -0,0 +1,172 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL2/SDL.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "frame_limiter.h"
+
+// clock_nanosleep sleeps against the same clock the deadlines are taken from
+#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(CLOCK_MONOTONIC)
+#define FRAME_LIMITER_NANOSLEEP 1
+#endif
+
+extern uint64_t frame_limiter_now(void)
+{
+#ifdef FRAME_LIMITER_NANOSLEEP
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    const Uint64 counter = SDL_GetPerformanceCounter(), freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000u + counter % freq * 1000000000u / freq;
+#endif
+}
+
+static void sleep_until(uint64_t time)
+{
+#ifdef FRAME_LIMITER_NANOSLEEP
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(time / 1000000000u);
+    ts.tv_nsec = (long)(time % 1000000000u);
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+    const uint64_t current = frame_limiter_now();
+
+    // whole milliseconds only, the spin makes up the rest
+    if(time > current + 1000000u)
+        SDL_Delay((Uint32)((time - current) / 1000000u));
+#endif
+}
+
+extern void frame_limiter_sleep_until(uint64_t time, uint64_t spin)
+{
+    const uint64_t current = frame_limiter_now();
+
+    if(current + spin < time)
+        sleep_until(time - spin);
+
+    while(frame_limiter_now() < time)
+        ;
+}
+
+static void add_error(struct frame_limiter *limiter, float error)
+{
+    if(limiter->errors_count == limiter->errors_capacity)
+    {
+        const size_t capacity = limiter->errors_capacity ? limiter->errors_capacity * 2 : 1024;
+        float *errors = (float*)realloc(limiter->errors, capacity * sizeof(float));
+
+        if(!errors)
+            return;
+
+        limiter->errors = errors;
+        limiter->errors_capacity = capacity;
+    }
+
+    limiter->errors[limiter->errors_count++] = error;
+}
+
+extern int frame_limiter_init(struct frame_limiter *limiter, double frame_time_ms, int spin_us)
+{
+    memset(limiter, 0, sizeof(*limiter));
+
+    if((frame_time_ms <= 0.0) || (spin_us < 0))
+        return 0;
+
+    limiter->period = (uint64_t)(frame_time_ms * 1e6 + 0.5);
+    limiter->spin = (uint64_t)spin_us * 1000u;
+
+    return 1;
+}
+
+extern void frame_limiter_free(struct frame_limiter *limiter)
+{
+    free(limiter->errors);
+    memset(limiter, 0, sizeof(*limiter));
+}
+
+extern void frame_limiter_wait(struct frame_limiter *limiter)
+{
+    uint64_t current = frame_limiter_now();
+
+    if(!limiter->deadline)
+    {
+        limiter->deadline = current;
+        return;
+    }
+
+    limiter->deadline += limiter->period;
+
+    if(current >= limiter->deadline + limiter->period)
+    {
+        limiter->missed++;
+        limiter->deadline = current;
+        return;
+    }
+
+    if(current + limiter->spin < limiter->deadline)
+    {
+        sleep_until(limiter->deadline - limiter->spin);
+
+        const uint64_t woken = frame_limiter_now();
+
+        limiter->slept += woken - current;
+        current = woken;
+    }
+
+    const uint64_t spin_start = current;
+
+    while(current < limiter->deadline)
+        current = frame_limiter_now();
+
+    limiter->spun += current - spin_start;
+
+    add_error(limiter, (float)((double)(current - limiter->deadline) / 1000.0));
+}
+
+static int compare_errors(const void *a, const void *b)
+{
+    const float x = *(const float*)a, y = *(const float*)b;
+
+    return (x > y) - (x < y);
+}
+
+extern void frame_limiter_report(struct frame_limiter *limiter, FILE *fp)
+{
+    fprintf(fp, "Pacing: %.3f ms period, %u missed", (double)limiter->period / 1e6, limiter->missed);
+
+    if(limiter->errors_count)
+    {
+        qsort(limiter->errors, limiter->errors_count, sizeof(float), compare_errors);
+
+        double total = 0.0;
+
+        for(size_t i = 0; i < limiter->errors_count; i++)
+            total += limiter->errors[i];
+
+        const size_t p99 = (limiter->errors_count * 99 + 99) / 100 - 1;
+
+        fprintf(fp, ", late by min %.1f avg %.1f p99 %.1f max %.1f us", limiter->errors[0], total / limiter->errors_count,
+                limiter->errors[p99], limiter->errors[limiter->errors_count - 1]);
+    }
+
+    const uint64_t waited = limiter->slept + limiter->spun;
+
+    if(waited)
+        fprintf(fp, ", %.1f%% of the wait slept", (double)limiter->slept * 100.0 / (double)waited);
+
+    fprintf(fp, "\n");
+}
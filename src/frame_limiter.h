@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_LIMITER_SPIN_US 300   // the end of a wait that is spun rather than slept
+
+// Paces frames to a fixed period. Most of the wait is slept, the last spin
+// microseconds are spun since a sleep can overshoot by about as much.
+struct frame_limiter
+{
+    uint64_t    period;         // ns
+    uint64_t    spin;           // ns
+    uint64_t    deadline;       // ns, 0 before the first frame
+
+    float      *errors;         // us past each deadline
+    size_t      errors_count;
+    size_t      errors_capacity;
+    unsigned    missed;         // frames that started a period or more late
+    uint64_t    slept;          // ns, for the CPU time saved
+    uint64_t    spun;
+};
+
+int frame_limiter_init(struct frame_limiter *limiter, double frame_time_ms, int spin_us);
+void frame_limiter_free(struct frame_limiter *limiter);
+
+// Returns at the start of the next period. A frame that missed its deadline
+// by a whole period starts the schedule over instead of catching up.
+void frame_limiter_wait(struct frame_limiter *limiter);
+
+// Wake up error min/avg/p99/max and the sleep/spin split
+void frame_limiter_report(struct frame_limiter *limiter, FILE *fp);
+
+// The clock the limiter runs on in ns, and the same sleep for other deadlines
+uint64_t frame_limiter_now(void);
+void frame_limiter_sleep_until(uint64_t time, uint64_t spin);
+
+#ifdef __cplusplus
+}
+#endif
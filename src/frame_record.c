@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame_record.h"
+
+#define FRAME_RECORD_MAGIC "FREC"
+
+// Chunk tags
+#define FRAME_RECORD_EVENTS 'P'         // batch polled at the top of the frame
+#define FRAME_RECORD_LATE 'L'           // batch polled late
+#define FRAME_RECORD_EVENT 'E'          // size byte, then the event cut to that size
+#define FRAME_RECORD_DELTA 'D'          // float seconds
+#define FRAME_RECORD_STATE 'S'          // 32 bit hash
+
+static void write_chunk(struct frame_record *record, unsigned char tag, const void *data, size_t size)
+{
+    if(record->failed)
+        return;
+
+    if((fputc(tag, record->fp) == EOF) || (size && (fwrite(data, size, 1, record->fp) != 1)))
+        record->failed = 1;
+}
+
+// Tag of the next chunk, 0 at the end
+static unsigned char peek_chunk(const struct frame_record *record)
+{
+    return record->offset < record->size ? record->data[record->offset] : 0;
+}
+
+// Takes the chunk after its tag, a chunk cut short ends the replay
+static int read_chunk(struct frame_record *record, void *data, size_t size)
+{
+    if(record->size - record->offset < 1 + size)
+    {
+        record->offset = record->size;
+        return 0;
+    }
+
+    memcpy(data, record->data + record->offset + 1, size);
+    record->offset += 1 + size;
+
+    return 1;
+}
+
+// FNV-1a
+static uint32_t hash_state(const void *state, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char*)state;
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    return hash;
+}
+
+// Only as much of the union as the event type uses
+static size_t event_size(Uint32 type)
+{
+    switch(type)
+    {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        return sizeof(SDL_KeyboardEvent);
+    case SDL_TEXTINPUT:
+        return sizeof(SDL_TextInputEvent);
+    case SDL_MOUSEMOTION:
+        return sizeof(SDL_MouseMotionEvent);
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        return sizeof(SDL_MouseButtonEvent);
+    case SDL_MOUSEWHEEL:
+        return sizeof(SDL_MouseWheelEvent);
+    case SDL_WINDOWEVENT:
+        return sizeof(SDL_WindowEvent);
+    default:
+        return sizeof(SDL_Event);
+    }
+}
+
+static int read_file(struct frame_record *record, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if(!fp)
+        return 0;
+
+    long size = -1;
+
+    if(!fseek(fp, 0, SEEK_END))
+        size = ftell(fp);
+
+    if((size <= 0) || fseek(fp, 0, SEEK_SET) || ((record->data = (unsigned char*)malloc((size_t)size)) == NULL))
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    record->size = (size_t)size;
+
+    const int read = fread(record->data, record->size, 1, fp) == 1;
+
+    fclose(fp);
+
+    return read;
+}
+
+extern int frame_record_init(struct frame_record *record, const char *path, int replay, float timestep)
+{
+    unsigned char header[12];
+    const uint32_t version = FRAME_RECORD_VERSION;
+
+    memset(record, 0, sizeof(*record));
+    record->replaying = replay;
+
+    memcpy(header, FRAME_RECORD_MAGIC, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &timestep, 4);
+
+    if(!replay)
+    {
+        if((record->fp = fopen(path, "wb")) == NULL)
+            return 0;
+
+        if(fwrite(header, sizeof(header), 1, record->fp) != 1)
+        {
+            frame_record_free(record);
+            return 0;
+        }
+
+        return 1;
+    }
+
+    // the timestep is compared bit for bit, any other one steps differently
+    if(!read_file(record, path) || (record->size < sizeof(header)) || memcmp(record->data, header, sizeof(header)))
+    {
+        frame_record_free(record);
+        return 0;
+    }
+
+    record->offset = sizeof(header);
+
+    return 1;
+}
+
+extern void frame_record_free(struct frame_record *record)
+{
+    if(record->fp)
+        fclose(record->fp);
+
+    free(record->data);
+    memset(record, 0, sizeof(*record));
+}
+
+extern void frame_record_begin_events(struct frame_record *record, int late)
+{
+    write_chunk(record, late ? FRAME_RECORD_LATE : FRAME_RECORD_EVENTS, NULL, 0);
+}
+
+extern void frame_record_event(struct frame_record *record, const SDL_Event *event)
+{
+    unsigned char chunk[1 + sizeof(SDL_Event)];
+    SDL_Event copy = *event;
+
+    // pointers don't outlive the run
+    if(copy.type >= SDL_USEREVENT)
+        copy.user.data1 = copy.user.data2 = NULL;
+
+    const size_t size = event_size(copy.type);
+
+    chunk[0] = (unsigned char)size;
+    memcpy(chunk + 1, &copy, size);
+
+    write_chunk(record, FRAME_RECORD_EVENT, chunk, 1 + size);
+    record->events++;
+}
+
+extern int frame_record_next_event(struct frame_record *record, SDL_Event *event, int late)
+{
+    for(;;)
+    {
+        const unsigned char tag = peek_chunk(record);
+
+        if((tag == FRAME_RECORD_EVENT) && (!late || record->batch))
+        {
+            const size_t size = record->size - record->offset < 2 ? 0 : record->data[record->offset + 1];
+
+            // cut short or not an event, the replay ends here
+            if((size < sizeof(Uint32)) || (size > sizeof(SDL_Event)) || (record->size - record->offset < 2 + size))
+            {
+                record->offset = record->size;
+                break;
+            }
+
+            memset(event, 0, sizeof(*event));
+            memcpy(event, record->data + record->offset + 2, size);
+            record->offset += 2 + size;
+            record->events++;
+
+            return 1;
+        }
+        else if((tag == FRAME_RECORD_EVENTS) && !late)
+            record->offset++;
+        else if((tag == FRAME_RECORD_LATE) && !record->batch)
+        {
+            record->offset++;
+            record->batch = late;
+        }
+        else
+            break;
+    }
+
+    record->batch = 0;
+
+    return 0;
+}
+
+extern int frame_record_delta(struct frame_record *record, float *delta)
+{
+    if(!record->replaying)
+    {
+        write_chunk(record, FRAME_RECORD_DELTA, delta, sizeof(*delta));
+        record->frames++;
+
+        return 1;
+    }
+
+    // whatever the frame didn't take before is skipped
+    for(;;)
+    {
+        const unsigned char tag = peek_chunk(record);
+
+        if(!tag)
+            return 0;
+
+        if(tag == FRAME_RECORD_DELTA)
+            break;
+
+        SDL_Event event;
+        uint32_t hash;
+
+        if(tag == FRAME_RECORD_STATE)
+            read_chunk(record, &hash, sizeof(hash));
+        else if((tag == FRAME_RECORD_EVENTS) || (tag == FRAME_RECORD_LATE) || (tag == FRAME_RECORD_EVENT))
+        {
+            while(frame_record_next_event(record, &event, 0))
+                ;
+        }
+        else
+            record->offset++;
+    }
+
+    if(!read_chunk(record, delta, sizeof(*delta)))
+        return 0;
+
+    record->frames++;
+
+    return 1;
+}
+
+extern void frame_record_state(struct frame_record *record, const void *state, size_t size)
+{
+    const uint32_t hash = hash_state(state, size);
+
+    if(!record->replaying)
+    {
+        write_chunk(record, FRAME_RECORD_STATE, &hash, sizeof(hash));
+        return;
+    }
+
+    uint32_t recorded;
+
+    if((peek_chunk(record) != FRAME_RECORD_STATE) || !read_chunk(record, &recorded, sizeof(recorded)))
+        return;
+
+    record->checked++;
+
+    if(recorded != hash)
+    {
+        if(!record->mismatches++)
+            record->diverged = record->frames;
+    }
+}
+
+extern void frame_record_report(const struct frame_record *record, FILE *fp)
+{
+    if(!record->replaying)
+    {
+        fprintf(fp, "Recorded %u frames, %u events%s\n", record->frames, record->events,
+                record->failed ? ", the file is cut short by a failed write" : "");
+        return;
+    }
+
+    fprintf(fp, "Replayed %u frames, %u events", record->frames, record->events);
+
+    if(record->mismatches)
+        fprintf(fp, ", state diverged at frame %u, %u of %u frames differ\n", record->diverged, record->mismatches, record->checked);
+    else if(record->checked)
+        fprintf(fp, ", state matched in all %u frames\n", record->checked);
+    else
+        fprintf(fp, "\n");
+}
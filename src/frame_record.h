@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL_events.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_RECORD_VERSION 1
+
+// Logs what makes a run differ from the next, the clamped delta of every frame and
+// the events handed to on_event, so a replay does the same steps with the same input.
+// The file is a header followed by one byte tagged chunks in the order they happened,
+// in the byte order of the machine that recorded it. A hash of the example state
+// after the update steps is logged too, a replay compares it frame by frame.
+struct frame_record
+{
+    int         replaying;
+
+    FILE       *fp;             // recording
+    int         failed;         // a write failed, the file is cut short
+
+    unsigned char *data;        // replaying, the whole file
+    size_t      size;
+    size_t      offset;
+    int         batch;          // inside a late batch
+
+    unsigned    frames;
+    unsigned    events;
+    unsigned    checked;        // frames whose state hash was compared
+    unsigned    mismatches;
+    unsigned    diverged;       // first frame whose state differed, 1-based
+};
+
+// Creates the file to record to, or reads all of it to replay. The timestep has to
+// match the one recorded with.
+int frame_record_init(struct frame_record *record, const char *path, int replay, float timestep);
+void frame_record_free(struct frame_record *record);
+
+// Recording: each event polling starts a batch, either at the top of the frame or late
+// from on_present. The events follow in the order they were handed to on_event.
+void frame_record_begin_events(struct frame_record *record, int late);
+void frame_record_event(struct frame_record *record, const SDL_Event *event);
+
+// Replaying: the next event of the batch, 0 at its end. At the top of the frame that
+// also takes late batches a run without late latching left over, late it only takes
+// a late batch.
+int frame_record_next_event(struct frame_record *record, SDL_Event *event, int late);
+
+// Logs the frame's delta, or replaces it with the recorded one. Returns 0 once the
+// replay ran out of frames.
+int frame_record_delta(struct frame_record *record, float *delta);
+// Logs the state after the update steps, or compares it with the recorded one
+void frame_record_state(struct frame_record *record, const void *state, size_t size);
+
+void frame_record_report(const struct frame_record *record, FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,280 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <stdio.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define IO_URING 1
+#endif
+#endif
+
+#include "io_batch.h"
+
+#define IO_RING_MAX_ENTRIES 256
+
+static void read_blocking(struct io_read *request)
+{
+    while(request->done < request->size)
+    {
+#ifdef _WIN32
+        const unsigned chunk = request->size - request->done > (1u << 30) ? (1u << 30) : (unsigned)(request->size - request->done);
+        const long result = _lseeki64(request->fd, (long long)request->done, SEEK_SET) < 0 ? -1 :
+                            _read(request->fd, (char*)request->buffer + request->done, chunk);
+#else
+        const ssize_t result = pread(request->fd, (char*)request->buffer + request->done, request->size - request->done, (off_t)request->done);
+#endif
+
+        if(result < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            request->error = errno;
+            return;
+        }
+
+        // the file got shorter since its size was taken
+        if(result == 0)
+        {
+            request->error = EIO;
+            return;
+        }
+
+        request->done += (size_t)result;
+    }
+
+    request->error = 0;
+}
+
+#ifdef IO_URING
+// The rings are shared with the kernel, only raw syscalls are used so no liburing is needed
+struct io_ring
+{
+    int         fd;
+    unsigned    entries;
+
+    void       *sq_ring;
+    size_t      sq_ring_size;
+    void       *cq_ring;
+    size_t      cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t      sqes_size;
+
+    unsigned   *sq_tail;
+    unsigned   *sq_mask;
+    unsigned   *sq_array;
+    unsigned   *cq_head;
+    unsigned   *cq_tail;
+    unsigned   *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static void free_ring(struct io_ring *ring)
+{
+    if(ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+
+    if(ring->cq_ring && (ring->cq_ring != ring->sq_ring))
+        munmap(ring->cq_ring, ring->cq_ring_size);
+
+    if(ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+
+    // closing waits for reads still in flight
+    if(ring->fd >= 0)
+        close(ring->fd);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int init_ring(struct io_ring *ring, unsigned entries)
+{
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+
+    // ENOSYS on old kernels, EPERM where seccomp or sysctl forbid it
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+    if(ring->fd < 0)
+        return 0;
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+
+    if(ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = NULL;
+        free_ring(ring);
+        return 0;
+    }
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cq_ring = ring->sq_ring;
+    else
+    {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+
+        if(ring->cq_ring == MAP_FAILED)
+        {
+            ring->cq_ring = NULL;
+            free_ring(ring);
+            return 0;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if(ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        free_ring(ring);
+        return 0;
+    }
+
+    uint8_t *sq = (uint8_t*)ring->sq_ring, *cq = (uint8_t*)ring->cq_ring;
+
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return 1;
+}
+
+// A read the ring couldn't finish keeps done < size and is left to read_blocking
+static void read_ring(struct io_ring *ring, struct io_read *reads, int count)
+{
+    int next = 0;
+    unsigned queued = 0, pending = 0;       // in the submission queue, with the kernel
+
+    while((next < count) || queued || pending)
+    {
+        unsigned tail = *ring->sq_tail;
+
+        for(; (next < count) && (pending + queued < ring->entries); next++)
+        {
+            struct io_read *request = &reads[next];
+
+            if(request->done >= request->size)
+                continue;
+
+            const unsigned index = tail & *ring->sq_mask;
+            struct io_uring_sqe *sqe = &ring->sqes[index];
+            const size_t length = request->size - request->done;
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = request->fd;
+            sqe->addr = (uint64_t)(uintptr_t)((char*)request->buffer + request->done);
+            sqe->len = length > 0x7ffff000 ? 0x7ffff000 : (unsigned)length;
+            sqe->off = request->done;
+            sqe->user_data = (uint64_t)next;
+
+            ring->sq_array[index] = index;
+            tail++;
+            queued++;
+        }
+
+        // only empty requests were left
+        if(!queued && !pending)
+            break;
+
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+        const long submitted = syscall(__NR_io_uring_enter, ring->fd, queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if(submitted < 0)
+        {
+            if((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+                continue;
+
+            return;
+        }
+
+        queued -= (unsigned)submitted;
+        pending += (unsigned)submitted;
+
+        unsigned head = *ring->cq_head;
+        const unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        for(; head != cq_tail; head++, pending--)
+        {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            struct io_read *request = &reads[cqe->user_data];
+
+            // failed and short reads are finished by read_blocking
+            if(cqe->res > 0)
+                request->done += (size_t)cqe->res;
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+#endif
+
+extern int io_read_batch(struct io_read *reads, int count, int flags)
+{
+    for(int i = 0; i < count; i++)
+    {
+        reads[i].done = 0;
+        reads[i].error = 0;
+    }
+
+#ifdef IO_URING
+    struct io_ring ring;
+
+    if(!(flags & IO_BATCH_BLOCKING) && (count > 1) &&
+       init_ring(&ring, count < IO_RING_MAX_ENTRIES ? (unsigned)count : IO_RING_MAX_ENTRIES))
+    {
+        read_ring(&ring, reads, count);
+        free_ring(&ring);
+    }
+#else
+    (void)flags;
+#endif
+
+    int completed = 0;
+
+    for(int i = 0; i < count; i++)
+    {
+        read_blocking(&reads[i]);
+
+        if(!reads[i].error)
+            completed++;
+    }
+
+    return completed;
+}
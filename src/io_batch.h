@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum IO_BATCH_FLAGS
+{
+    IO_BATCH_BLOCKING = 1           // skip io_uring, read with pread one file at a time
+};
+
+// Whole-file read into a preallocated buffer
+struct io_read
+{
+    int         fd;
+    void       *buffer;
+    size_t      size;               // bytes to read from the start of the file
+    size_t      done;               // bytes read so far
+    int         error;              // errno of a failed read, 0 otherwise
+};
+
+// Reads every request in full. On Linux all reads are submitted as one io_uring batch
+// when the kernel allows it, whatever it leaves unfinished (short reads, unsupported
+// ops, no io_uring at all) is completed with blocking reads. Returns the number of
+// requests read in full.
+int io_read_batch(struct io_read *reads, int count, int flags);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,10 +1,29 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include <glcore_450.h>
 #include "common.h"
+#include "frame_fences.h"
+#include "frame_latency.h"
+#include "frame_limiter.h"
+#include "frame_record.h"
+#include "profiler.h"
+#include "spsc_ring.h"
+#include "triple_buffer.h"
 
 #define SCREEN_WIDTH 1024
 #define SCREEN_HEIGHT 768
 #define TIMESTEP 0.001f
+#define HEADLESS_FRAMES 1000
+#define FRAMES_IN_FLIGHT 2
+#define FRAME_PACKETS 4
+#define FLOOD_PERIOD 16
+#define HOST_MAX_EXAMPLES 64
+
+#ifndef EXAMPLE_HOST
 
 void on_init(int w, int h, int vsync);
 void on_quit(void);
@@ -13,8 +32,287 @@ void on_update(float dt);
 void on_present(int w, int h, float alpha);
 void on_event(SDL_Event *event);
 
+// Optional, runs all the steps due in one call. Without it on_update is called per step.
+void on_update_n(unsigned int steps, float dt);
+
+// Optional, an example keeping what on_present draws apart from what on_update
+// changes can simulate on a thread of its own. on_save_state copies the state after
+// the last step, on_load_state hands a copy to on_present.
+size_t on_state_size(void);
+void on_save_state(void *state);
+void on_load_state(const void *state);
+
+// Without a hook of its own an example gets the default
+#define OPTIONAL_HOOK(type, name) __attribute__((weak)) type name
+
+#else
+
+// The host fills these in from each example's shared object before it runs it
+static void (*on_init)(int w, int h, int vsync);
+static void (*on_quit)(void);
+static void (*on_cleanup)(void);
+static void (*on_update)(float dt);
+static void (*on_present)(int w, int h, float alpha);
+static void (*on_event)(SDL_Event *event);
+static void (*on_update_n)(unsigned int steps, float dt);
+static size_t (*on_state_size)(void);
+static void (*on_save_state)(void *state);
+static void (*on_load_state)(const void *state);
+
+#define OPTIONAL_HOOK(type, name) static type default_##name
+
+#endif
+
+// For on_present, handles the events that arrived since the top of the frame right
+// before the view is built. Does nothing unless -latency is on or a replay recorded it.
+void latch_input(void);
+
 volatile int quit = 1;
 
+// Per-frame resources are versioned by slot, frame_slots is set before on_init and
+// frame_slot before each on_present. The GPU is done with a slot when it comes round again.
+int frame_slots = 1;
+int frame_slot = 0;
+
+// How an example that has several ways of loading its textures loads them, set by
+// -textures. NULL leaves the choice to the example.
+const char *texture_loader = NULL;
+
+OPTIONAL_HOOK(void, on_update_n)(unsigned int steps, float dt) {
+    for (unsigned int i = 0; i < steps; i++)
+        on_update(dt);
+}
+
+OPTIONAL_HOOK(size_t, on_state_size)(void) {
+    return 0;
+}
+
+OPTIONAL_HOOK(void, on_save_state)(void *state) {
+    UNUSED(state);
+}
+
+OPTIONAL_HOOK(void, on_load_state)(const void *state) {
+    UNUSED(state);
+}
+
+struct snapshot {
+    Uint64 time;            // performance counter the last step simulated up to, 0 before the first
+    _Alignas(max_align_t) unsigned char state[];
+};
+
+struct simulation {
+    struct triple_buffer snapshots;
+    SDL_atomic_t running;
+    SDL_Thread *thread;
+    unsigned int timesteps;
+};
+
+// Runs on_update in fixed steps keeping up with the clock, independent of the frame rate
+static int simulate(void *data) {
+    struct simulation *simulation = (struct simulation*)data;
+
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 step = (Uint64)((double)freq * TIMESTEP + 0.5);
+    Uint64 simulated = SDL_GetPerformanceCounter();
+
+    while (SDL_AtomicGet(&simulation->running)) {
+        Uint64 current = SDL_GetPerformanceCounter();
+
+        // Same limit as the main loop, a long stall isn't made up for
+        if (current - simulated > freq / 5)
+            simulated = current - freq / 5;
+
+        if (current - simulated < step) {
+            SDL_Delay(1);
+            continue;
+        }
+
+        unsigned int steps = (unsigned int)((current - simulated) / step);
+
+        on_update_n(steps, TIMESTEP);
+
+        simulated += steps * step;
+        simulation->timesteps += steps;
+
+        struct snapshot *snapshot = (struct snapshot*)triple_buffer_back(&simulation->snapshots);
+
+        snapshot->time = simulated;
+        on_save_state(snapshot->state);
+
+        triple_buffer_publish(&simulation->snapshots);
+    }
+
+    return 0;
+}
+
+struct frame_packet {
+    Uint64 time;            // performance counter the state was simulated up to, 0 before the first step
+    _Alignas(max_align_t) unsigned char state[];
+};
+
+static struct frame_latency *latched;     // -latency without a render thread
+static struct frame_record *record;       // -record or -replay
+static int closed;                        // the window was closed, the host stops after this example
+
+// Late when called from on_present. A replay only takes the quit from the window,
+// everything else comes from the file.
+static void poll_events(int late) {
+    SDL_Event event;
+
+    if (record && !record->replaying)
+        frame_record_begin_events(record, late);
+
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT)
+            closed = 1, on_quit();
+        else if (!record)
+            on_event(&event);
+        else if (!record->replaying) {
+            frame_record_event(record, &event);
+            on_event(&event);
+        }
+    }
+
+    while (record && record->replaying && frame_record_next_event(record, &event, late))
+        on_event(&event);
+}
+
+void latch_input(void) {
+    if (!latched && !(record && record->replaying))
+        return;
+
+    poll_events(1);
+
+    if (latched)
+        frame_latency_input(latched);
+}
+
+// What on_present and the swap need, owned by the render thread when there is one
+struct presenter {
+    SDL_Window *window;
+    SDL_GLContext context;
+    GLuint framebuffer;     // offscreen when headless, 0 for the window
+    int width;
+    int height;
+
+    struct frame_fences fences;
+    struct frame_limiter limiter;
+    int limited;
+    struct frame_latency *latency;  // without a render thread
+
+    SDL_atomic_t frames;    // presented so far
+    Uint64 frame_last;
+    unsigned int frame_count;
+    double frame_sum;       // ms, for the frame time variance
+    double frame_squares;
+    double frame_max;
+
+    SDL_Thread *thread;
+    SDL_atomic_t running;
+    struct spsc_ring packets;
+    struct frame_packet *packet;    // latest taken from the ring
+    size_t packet_size;
+    SDL_sem *presented;     // posted per frame, paces the main thread
+};
+
+static void render_frame(struct presenter *presenter, float alpha) {
+    if (presenter->framebuffer)
+        glBindFramebuffer(GL_FRAMEBUFFER, presenter->framebuffer);
+
+    int zone = profiler_begin("fence");
+    frame_slot = frame_fences_begin(&presenter->fences);
+    profiler_end(zone);
+
+    zone = profiler_begin("present");
+    int gpu_zone = profiler_gpu_begin("present");
+
+    on_present(presenter->width, presenter->height, alpha);
+
+    profiler_gpu_end(gpu_zone);
+    profiler_end(zone);
+
+    zone = profiler_begin("swap");
+
+    if (presenter->latency)
+        frame_latency_submitted(presenter->latency);
+
+    // Stands in for the swap when headless, the frame fences hold the CPU back as
+    // a swap chain would
+    if (presenter->framebuffer)
+        glFlush();
+    else
+        SDL_GL_SwapWindow(presenter->window);
+
+    if (presenter->latency)
+        frame_latency_swapped(presenter->latency);
+
+    profiler_end(zone);
+
+    frame_fences_end(&presenter->fences);
+    profiler_frame();
+
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    if (presenter->frame_last) {
+        double ms = (double)(now - presenter->frame_last) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+        presenter->frame_count++;
+        presenter->frame_sum += ms;
+        presenter->frame_squares += ms * ms;
+
+        if (ms > presenter->frame_max)
+            presenter->frame_max = ms;
+    }
+
+    presenter->frame_last = now;
+    SDL_AtomicAdd(&presenter->frames, 1);
+}
+
+// Presents the latest packet at its own pace, a stalled main thread only means
+// the same state is drawn again
+static int render(void *data) {
+    struct presenter *presenter = (struct presenter*)data;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+
+    SDL_GL_MakeCurrent(presenter->window, presenter->context);
+
+    while (SDL_AtomicGet(&presenter->running)) {
+        if (presenter->limited) {
+            int zone = profiler_begin("wait");
+            frame_limiter_wait(&presenter->limiter);
+            profiler_end(zone);
+        }
+
+        const struct frame_packet *packet;
+
+        // Older packets were overtaken
+        while ((packet = (const struct frame_packet*)spsc_ring_peek(&presenter->packets)) != NULL) {
+            memcpy(presenter->packet, packet, presenter->packet_size);
+            spsc_ring_pop(&presenter->packets);
+        }
+
+        on_load_state(presenter->packet->state);
+
+        Uint64 current = SDL_GetPerformanceCounter();
+        float alpha = 0.0f;
+
+        if (presenter->packet->time && (current > presenter->packet->time))
+            alpha = (float)((double)(current - presenter->packet->time) / (double)freq / TIMESTEP);
+
+        if (alpha > 1.0f)
+            alpha = 1.0f;
+
+        render_frame(presenter, alpha);
+
+        SDL_SemPost(presenter->presented);
+    }
+
+    glFinish();
+    SDL_GL_MakeCurrent(presenter->window, NULL);
+
+    return 0;
+}
+
 static const char *debug_source_to_string(GLenum source) {
     switch (source) {
     case GL_DEBUG_SOURCE_API:
@@ -83,61 +381,243 @@ static void APIENTRY debug_output_callback(GLenum source, GLenum type, GLuint id
     fprintf(stderr, "%s:%s[%s](%d) %s\n", sourceStr, typeStr, severityStr, id, message);
 }
 
-extern int
-main(int argc, char *argv[]) {
-    UNUSED(argc), UNUSED(argv);
+struct options {
+    int headless;       // no visible window, frames go to an offscreen framebuffer
+    int width;
+    int height;
+    int frames;         // quit after this many frames, 0 runs until the window is closed
+    int vsync;
+    double frame_time;      // ms, frames are paced to it when set
+    int frames_in_flight;   // 1 to FRAME_FENCES_MAX
+    int simulation_thread;  // on_update runs on a thread of its own
+    int render_thread;      // so do on_present and the swap
+    int flood;              // synthetic events pushed in a burst every FLOOD_PERIOD iterations
+    int latency;            // just-in-time frame start and late input latching
+    const char *record;     // deltas and events logged to or replayed from this file
+    int replay;
+    int profile;        // per-zone statistics at exit
+    const char *trace;  // Chrome trace written at exit, implies -profile
+    const char *textures;   // texture loader of the examples that have several
+#ifdef EXAMPLE_HOST
+    const char *examples[HOST_MAX_EXAMPLES];    // shared objects, run in this order
+    int examples_count;
+#endif
+};
 
-    int width = SCREEN_WIDTH, height = SCREEN_HEIGHT;
-    int vsync = 0;
+#ifdef EXAMPLE_HOST
+#define USAGE_EXAMPLES " example.so ..."
+#else
+#define USAGE_EXAMPLES ""
+#endif
 
-    SDL_Window *window;
-    SDL_GLContext context;
+static void print_usage(const char *program) {
+    printf("usage: %s [-headless] [-size WIDTHxHEIGHT] [-frames count] [-vsync] [-fps rate | -frametime ms] [-inflight 1-3] [-simthread] [-renderthread] [-latency] [-record file | -replay file] [-flood events] [-profile] [-trace file.json] [-textures dds|array|stream|pool]" USAGE_EXAMPLES "\n", program);
+}
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("SDL_Error: %s\n", SDL_GetError());
-        return 0;
+static int parse_options(int argc, char *argv[], struct options *options) {
+    options->headless = 0;
+    options->width = SCREEN_WIDTH;
+    options->height = SCREEN_HEIGHT;
+    options->frames = -1;
+    options->vsync = 0;
+    options->frame_time = 0.0;
+    options->frames_in_flight = FRAMES_IN_FLIGHT;
+    options->simulation_thread = 0;
+    options->render_thread = 0;
+    options->flood = 0;
+    options->latency = 0;
+    options->record = NULL;
+    options->replay = 0;
+    options->profile = 0;
+    options->trace = NULL;
+    options->textures = NULL;
+#ifdef EXAMPLE_HOST
+    options->examples_count = 0;
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-headless"))
+            options->headless = 1;
+        else if (!strcmp(argv[i], "-vsync"))
+            options->vsync = 1;
+        else if (!strcmp(argv[i], "-fps") && (i + 1 < argc) && (atof(argv[i + 1]) > 0.0))
+            options->frame_time = 1000.0 / atof(argv[++i]);
+        else if (!strcmp(argv[i], "-frametime") && (i + 1 < argc) && (atof(argv[i + 1]) > 0.0))
+            options->frame_time = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-inflight") && (i + 1 < argc) && (atoi(argv[i + 1]) >= 1) && (atoi(argv[i + 1]) <= FRAME_FENCES_MAX))
+            options->frames_in_flight = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-simthread"))
+            options->simulation_thread = 1;
+        else if (!strcmp(argv[i], "-renderthread"))
+            options->render_thread = 1;
+        else if (!strcmp(argv[i], "-latency"))
+            options->latency = 1;
+        else if (!strcmp(argv[i], "-record") && (i + 1 < argc))
+            options->record = argv[++i], options->replay = 0;
+        else if (!strcmp(argv[i], "-replay") && (i + 1 < argc))
+            options->record = argv[++i], options->replay = 1;
+        else if (!strcmp(argv[i], "-flood") && (i + 1 < argc) && (atoi(argv[i + 1]) >= 0))
+            options->flood = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-profile"))
+            options->profile = 1;
+        else if (!strcmp(argv[i], "-trace") && (i + 1 < argc))
+            options->trace = argv[++i], options->profile = 1;
+        else if (!strcmp(argv[i], "-textures") && (i + 1 < argc))
+            options->textures = argv[++i];
+        else if (!strcmp(argv[i], "-size") && (i + 1 < argc) && (sscanf(argv[i + 1], "%dx%d", &options->width, &options->height) == 2) &&
+                 (options->width > 0) && (options->height > 0))
+            i++;
+        else if (!strcmp(argv[i], "-frames") && (i + 1 < argc) && (atoi(argv[i + 1]) >= 0))
+            options->frames = atoi(argv[++i]);
+#ifdef EXAMPLE_HOST
+        else if ((argv[i][0] != '-') && (options->examples_count < HOST_MAX_EXAMPLES))
+            options->examples[options->examples_count++] = argv[i];
+#endif
+        else {
+            print_usage(argv[0]);
+            return 0;
+        }
     }
 
-    if ((window = SDL_CreateWindow(APP_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN)) == NULL) {
-        printf("SDL_Error: %s\n", SDL_GetError());
+#ifdef EXAMPLE_HOST
+    if (!options->examples_count) {
+        print_usage(argv[0]);
         return 0;
     }
+#endif
 
-    SDL_GetWindowSize(window, &width, &height);
+#ifdef EXAMPLE_HOST
+    // Every example runs for a while, closing the window ends the whole run
+    if (options->frames < 0)
+        options->frames = HEADLESS_FRAMES;
+#endif
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG | SDL_GL_CONTEXT_DEBUG_FLAG);
+    // A headless run has no window to close
+    if (options->frames < 0)
+        options->frames = options->headless ? HEADLESS_FRAMES : 0;
 
-    if ((context = SDL_GL_CreateContext(window)) == NULL) {
-        printf("SDL_Error: %s\n", SDL_GetError());
+    return 1;
+}
+
+// Color and depth renderbuffers standing in for the window's framebuffer
+static GLuint create_offscreen_framebuffer(int width, int height, GLuint renderbuffers[2]) {
+    GLuint framebuffer;
+
+    glCreateRenderbuffers(2, renderbuffers);
+    glNamedRenderbufferStorage(renderbuffers[0], GL_RGBA8, width, height);
+    glNamedRenderbufferStorage(renderbuffers[1], GL_DEPTH_COMPONENT24, width, height);
+
+    glCreateFramebuffers(1, &framebuffer);
+    glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+    if (glCheckNamedFramebufferStatus(framebuffer, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
         return 0;
     }
 
-    glLoadFunctions();
-    glLoadExtensions();
-
-    glDebugMessageCallback(debug_output_callback, NULL);
-    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+    return framebuffer;
+}
 
-    glEnable(GL_DEBUG_OUTPUT);
+// One example from on_init to on_cleanup, in the window and context set up by main.
+// Returns the frames it presented.
+static int run(const struct options *options, SDL_Window *window, SDL_GLContext context, GLuint framebuffer, int width, int height, int vsync) {
+    struct presenter presenter;
 
-    const char *version = (const char*)glGetString(GL_VERSION);
-    const char *renderer = (const char*)glGetString(GL_RENDERER);
-    const char *vendor = (const char*)glGetString(GL_VENDOR);
-    const char *glsl_version = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+    memset(&presenter, 0, sizeof(presenter));
+    presenter.window = window;
+    presenter.context = context;
+    presenter.framebuffer = framebuffer;
+    presenter.width = width;
+    presenter.height = height;
 
-    printf("GL version: %s\nGL renderer: %s\nGL vendor: %s\nGL shading language version: %s\n", version, renderer, vendor, glsl_version);
+    frame_fences_init(&presenter.fences, options->frames_in_flight);
+    frame_slots = presenter.fences.count;
 
     on_init(width, height, vsync);
 
+    if (options->profile)
+        profiler_init();
+
     if (vsync)
         SDL_GL_SetSwapInterval(1);
 
-    SDL_Event event;
+    // Snapshots of the example state, handed over by the simulation thread or copied
+    // after the update steps
+    size_t state_size = on_state_size();
+    struct snapshot *snapshot = NULL;
+    struct simulation simulation;
+
+    simulation.thread = NULL;
+
+    if (options->simulation_thread && !state_size)
+        printf("Simulation thread: on_state_size not provided, -simthread ignored\n");
+
+    if (options->simulation_thread && state_size) {
+        if (triple_buffer_init(&simulation.snapshots, sizeof(struct snapshot) + state_size)) {
+            simulation.timesteps = 0;
+            SDL_AtomicSet(&simulation.running, 1);
+
+            if ((simulation.thread = SDL_CreateThread(simulate, "simulation", &simulation)) == NULL) {
+                printf("SDL_Error: %s\n", SDL_GetError());
+                triple_buffer_free(&simulation.snapshots);
+            }
+        }
+    }
+
+    presenter.limited = options->frame_time > 0.0 && frame_limiter_init(&presenter.limiter, options->frame_time, FRAME_LIMITER_SPIN_US);
+
+    // The context moves to the render thread, the state follows in frame packets
+    if (options->render_thread && !state_size)
+        printf("Render thread: on_state_size not provided, -renderthread ignored\n");
+
+    if (options->render_thread && state_size) {
+        presenter.packet_size = sizeof(struct frame_packet) + state_size;
+        presenter.packet = (struct frame_packet*)calloc(1, presenter.packet_size);
+        presenter.presented = SDL_CreateSemaphore(0);
+
+        if (presenter.packet && presenter.presented && spsc_ring_init(&presenter.packets, presenter.packet_size, FRAME_PACKETS)) {
+            SDL_AtomicSet(&presenter.running, 1);
+            SDL_GL_MakeCurrent(window, NULL);
+
+            if ((presenter.thread = SDL_CreateThread(render, "render", &presenter)) == NULL) {
+                printf("SDL_Error: %s\n", SDL_GetError());
+                SDL_GL_MakeCurrent(window, context);
+            }
+        }
+
+        if (!presenter.thread) {
+            spsc_ring_free(&presenter.packets);
+            free(presenter.packet);
+
+            if (presenter.presented)
+                SDL_DestroySemaphore(presenter.presented);
+        }
+    }
+
+    if (!simulation.thread && !presenter.thread && state_size)
+        snapshot = (struct snapshot*)calloc(1, sizeof(struct snapshot) + state_size);
+
+    // The latency is estimated either way, -latency acts on it. Events are only
+    // polled on the main thread, so a render thread can't latch them late.
+    struct frame_latency latency;
+
+    // Only a swap that waits for the display gives the start a deadline to aim at,
+    // without one a later start is just a longer frame
+    frame_latency_init(&latency, options->latency && vsync, FRAME_LATENCY_MARGIN_US);
+
+    if (options->latency && presenter.thread)
+        printf("Latency: no late input latching with a render thread, -latency ignored\n");
+    else if (options->latency && !vsync)
+        printf("Latency: no just-in-time start without vsync, input is still latched late\n");
+
+    if (!presenter.thread) {
+        presenter.latency = &latency;
+
+        if (options->latency)
+            latched = &latency;
+    }
 
     Uint64 current = 0;
     Uint64 last = 0;
@@ -145,43 +625,422 @@ main(int argc, char *argv[]) {
     unsigned int timesteps = 0;
     float accumulator = 0.0f;
 
+    unsigned int iterations = 0;
+    Uint64 frames_start = SDL_GetPerformanceCounter();
+
     while (quit) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT)
-                on_quit();
-            else
-                on_event(&event);
+        int zone;
+
+        if (presenter.limited && !presenter.thread) {
+            zone = profiler_begin("wait");
+            frame_limiter_wait(&presenter.limiter);
+            profiler_end(zone);
+        }
+
+        if (presenter.latency) {
+            zone = profiler_begin("start");
+            frame_latency_start(&latency);
+            profiler_end(zone);
+        }
+
+        zone = profiler_begin("events");
+
+        // Stands in for a window system hiccup
+        for (int i = 0; (iterations % FLOOD_PERIOD == 0) && (i < options->flood); i++) {
+            SDL_Event flood;
+
+            memset(&flood, 0, sizeof(flood));
+            flood.type = SDL_USEREVENT;
+            SDL_PushEvent(&flood);
         }
 
+        poll_events(0);
+
+        profiler_end(zone);
+
         last = current;
         current = SDL_GetPerformanceCounter();
         Uint64 freq = SDL_GetPerformanceFrequency();
 
         float delta = (double)(current - last) / (double)freq;
 
-        if (delta <= 0.0f)
-            continue;
+        // A counter that hasn't moved yet is no reason to spin, the frame goes on without steps
+        if (delta < 0.0f)
+            delta = 0.0f;
 
         if (delta > 0.2)
             delta = 0.2;
 
-        accumulator += delta;
+        // Done once the replay runs out of frames
+        if (record && !frame_record_delta(record, &delta)) {
+            on_quit();
+            break;
+        }
+
+        zone = profiler_begin("update");
+
+        if (!simulation.thread) {
+            accumulator += delta;
+
+            unsigned int steps = (unsigned int)(accumulator / TIMESTEP);
+
+            // The division may round up, the accumulator never goes negative
+            while (steps && (steps * TIMESTEP > accumulator))
+                steps--;
+
+            if (steps) {
+                accumulator -= steps * TIMESTEP;
+
+                on_update_n(steps, TIMESTEP);
+
+                timesteps += steps;
+            }
+        }
+
+        if (presenter.thread) {
+            struct frame_packet *packet = (struct frame_packet*)spsc_ring_reserve(&presenter.packets);
+
+            // A full ring means the render thread is behind, it only takes the latest anyway
+            if (packet) {
+                if (simulation.thread) {
+                    const struct snapshot *latest = (const struct snapshot*)triple_buffer_front(&simulation.snapshots);
+
+                    packet->time = latest->time;
+                    memcpy(packet->state, latest->state, state_size);
+                } else {
+                    packet->time = current - (Uint64)((double)accumulator * (double)freq);
+                    on_save_state(packet->state);
+                }
+
+                spsc_ring_push(&presenter.packets);
+            }
+        } else if (simulation.thread) {
+            const struct snapshot *latest = (const struct snapshot*)triple_buffer_front(&simulation.snapshots);
+
+            on_load_state(latest->state);
+
+            // Time since the last step, as the accumulator would hold it. The step may
+            // also have been published after current was taken.
+            accumulator = 0.0f;
+
+            if (latest->time && (current > latest->time))
+                accumulator = (float)((double)(current - latest->time) / (double)freq);
+
+            if (accumulator > TIMESTEP)
+                accumulator = TIMESTEP;
+        } else if (snapshot) {
+            on_save_state(snapshot->state);
+            on_load_state(snapshot->state);
+
+            if (record)
+                frame_record_state(record, snapshot->state, state_size);
+        }
+
+        profiler_end(zone);
+
+        // One packet per frame presented, the timeout keeps events flowing if rendering hangs
+        if (presenter.thread)
+            SDL_SemWaitTimeout(presenter.presented, 100);
+        else
+            render_frame(&presenter, accumulator / TIMESTEP);
+
+        if (options->frames && (SDL_AtomicGet(&presenter.frames) >= options->frames))
+            on_quit();
+
+        iterations++;
+    }
+
+    if (presenter.thread) {
+        SDL_AtomicSet(&presenter.running, 0);
+        SDL_WaitThread(presenter.thread, NULL);
+        SDL_GL_MakeCurrent(window, context);
+
+        spsc_ring_free(&presenter.packets);
+        free(presenter.packet);
+        SDL_DestroySemaphore(presenter.presented);
+    }
+
+    if (simulation.thread) {
+        SDL_AtomicSet(&simulation.running, 0);
+        SDL_WaitThread(simulation.thread, NULL);
+        triple_buffer_free(&simulation.snapshots);
 
-        while (accumulator >= TIMESTEP) {
-            accumulator -= TIMESTEP;
+        timesteps = simulation.timesteps;
+    }
+
+    free(snapshot);
+
+    if (options->frames) {
+        glFinish();
+
+        int frames = SDL_AtomicGet(&presenter.frames);
+        double elapsed = (double)(SDL_GetPerformanceCounter() - frames_start) / (double)SDL_GetPerformanceFrequency();
+
+        printf("%d frames in %.2f ms, %.3f ms per frame (%.1f fps), %u timesteps\n", frames, elapsed * 1000.0,
+               elapsed * 1000.0 / frames, frames / elapsed, timesteps);
 
-            on_update(TIMESTEP);
+        if (presenter.frame_count) {
+            double mean = presenter.frame_sum / presenter.frame_count;
+            double variance = presenter.frame_squares / presenter.frame_count - mean * mean;
 
-            timesteps++;
+            printf("Frame time: avg %.3f ms, stddev %.3f ms, max %.3f ms\n", mean, sqrt(variance > 0.0 ? variance : 0.0), presenter.frame_max);
         }
 
-        on_present(width, height, accumulator / TIMESTEP);
+        frame_fences_report(&presenter.fences, stdout);
+
+        if (presenter.latency)
+            frame_latency_report(&latency, stdout);
+    }
+
+    frame_fences_free(&presenter.fences);
+
+    if (presenter.limited) {
+        frame_limiter_report(&presenter.limiter, stdout);
+        frame_limiter_free(&presenter.limiter);
+    }
+
+    if (record) {
+        frame_record_report(record, stdout);
+        frame_record_free(record);
+    }
+
+    if (options->profile) {
+        profiler_report(stdout);
 
-        SDL_GL_SwapWindow(window);
+        if (options->trace && !profiler_write_trace(options->trace))
+            printf("Can't write trace %s\n", options->trace);
+
+        profiler_shutdown();
     }
 
     on_cleanup();
 
+    latched = NULL;
+
+    return SDL_AtomicGet(&presenter.frames);
+}
+
+#ifdef EXAMPLE_HOST
+
+// Loads the hooks of an example built as a shared object, the optional ones it
+// doesn't export fall back to the defaults. Returns NULL when a required one is missing.
+static void* load_example(const char *path) {
+    static const struct {
+        const char *name;
+        void *hook;         // the function pointer to fill in
+        int optional;
+    } hooks[] = {
+        {"on_init", &on_init, 0},
+        {"on_quit", &on_quit, 0},
+        {"on_cleanup", &on_cleanup, 0},
+        {"on_update", &on_update, 0},
+        {"on_present", &on_present, 0},
+        {"on_event", &on_event, 0},
+        {"on_update_n", &on_update_n, 1},
+        {"on_state_size", &on_state_size, 1},
+        {"on_save_state", &on_save_state, 1},
+        {"on_load_state", &on_load_state, 1},
+    };
+
+    void *object = SDL_LoadObject(path);
+
+    if (!object) {
+        printf("SDL_Error: %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    for (size_t i = 0; i < sizeof(hooks) / sizeof(hooks[0]); i++) {
+        void *function = SDL_LoadFunction(object, hooks[i].name);
+
+        if (!function && !hooks[i].optional) {
+            printf("%s: %s not found\n", path, hooks[i].name);
+            SDL_UnloadObject(object);
+            return NULL;
+        }
+
+        // ISO C has no cast from an object pointer to a function pointer
+        memcpy(hooks[i].hook, &function, sizeof(function));
+    }
+
+    if (!on_update_n)
+        on_update_n = default_on_update_n;
+
+    if (!on_state_size)
+        on_state_size = default_on_state_size;
+
+    if (!on_save_state)
+        on_save_state = default_on_save_state;
+
+    if (!on_load_state)
+        on_load_state = default_on_load_state;
+
+    return object;
+}
+
+// Runs the examples back to back in the one window and context, listing one more
+// than once repeats it
+static void run_examples(const struct options *options, SDL_Window *window, SDL_GLContext context, GLuint framebuffer, int width, int height, int vsync) {
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 suite_start = SDL_GetPerformanceCounter();
+    int examples = 0;
+
+    for (int i = 0; (i < options->examples_count) && !closed; i++) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        void *object = load_example(options->examples[i]);
+
+        if (!object)
+            continue;
+
+        printf("Example %s\n", options->examples[i]);
+
+        quit = 1;
+        frame_slot = 0;
+
+        int frames = run(options, window, context, framebuffer, width, height, vsync);
+
+        // on_cleanup deleted the example's objects, what it left bound or enabled isn't the next one's business
+        glFinish();
+        glUseProgram(0);
+        glBindVertexArray(0);
+        glDisable(GL_DEPTH_TEST);
+
+        SDL_UnloadObject(object);
+
+        printf("Example %s: %d frames, %.2f ms from load to unload\n", options->examples[i], frames,
+               (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)freq);
+
+        examples++;
+    }
+
+    printf("%d examples in %.2f ms, one context\n", examples, (double)(SDL_GetPerformanceCounter() - suite_start) * 1000.0 / (double)freq);
+}
+
+#endif
+
+extern int
+main(int argc, char *argv[]) {
+    struct options options;
+
+    if (!parse_options(argc, argv, &options))
+        return 1;
+
+    texture_loader = options.textures;
+
+#ifdef EXAMPLE_HOST
+    // Every example would overwrite the file of the one before
+    if (options.record || options.trace) {
+        printf("Host: -record, -replay and -trace ignored\n");
+        options.record = options.trace = NULL;
+    }
+#endif
+
+    struct frame_record recorded;
+
+    if (options.record && !frame_record_init(&recorded, options.record, options.replay, TIMESTEP)) {
+        printf(options.replay ? "Can't replay %s\n" : "Can't record to %s\n", options.record);
+        return 1;
+    }
+
+    // Steps only repeat when the frame's delta decides them, the threads keep time on their own
+    if (options.record && (options.simulation_thread || options.render_thread)) {
+        printf("%s: -simthread and -renderthread ignored\n", options.replay ? "Replay" : "Record");
+        options.simulation_thread = options.render_thread = 0;
+    }
+
+    if (options.record)
+        record = &recorded;
+
+    int width = options.width, height = options.height;
+    int vsync = options.vsync;
+
+    SDL_Window *window;
+    SDL_GLContext context;
+
+    // The offscreen driver needs no display, SDL_VIDEODRIVER set by the user still wins
+    if (options.headless)
+        SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        if (!options.headless) {
+            printf("SDL_Error: %s\n", SDL_GetError());
+            return 0;
+        }
+
+        // SDL built without it, a hidden window of the default driver is next best
+        SDL_setenv("SDL_VIDEODRIVER", "", 1);
+
+        if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+            printf("SDL_Error: %s\n", SDL_GetError());
+            return 0;
+        }
+    }
+
+    Uint32 window_flags = SDL_WINDOW_OPENGL | (options.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN);
+
+    if ((window = SDL_CreateWindow(APP_TITLE, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, window_flags)) == NULL) {
+        printf("SDL_Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    if (!options.headless)
+        SDL_GetWindowSize(window, &width, &height);
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG | SDL_GL_CONTEXT_DEBUG_FLAG);
+
+    if ((context = SDL_GL_CreateContext(window)) == NULL) {
+        printf("SDL_Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    glLoadFunctions();
+    glLoadExtensions();
+
+    glDebugMessageCallback(debug_output_callback, NULL);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+
+    glEnable(GL_DEBUG_OUTPUT);
+
+    const char *version = (const char*)glGetString(GL_VERSION);
+    const char *renderer = (const char*)glGetString(GL_RENDERER);
+    const char *vendor = (const char*)glGetString(GL_VENDOR);
+    const char *glsl_version = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+
+    printf("GL version: %s\nGL renderer: %s\nGL vendor: %s\nGL shading language version: %s\n", version, renderer, vendor, glsl_version);
+
+    GLuint framebuffer = 0;
+    GLuint renderbuffers[2] = {0, 0};
+
+    if (options.headless) {
+        if ((framebuffer = create_offscreen_framebuffer(width, height, renderbuffers)) == 0) {
+            printf("Offscreen framebuffer %dx%d is incomplete\n", width, height);
+            return 0;
+        }
+
+        printf("Headless: %dx%d, %d frames (%s video driver)\n", width, height, options.frames, SDL_GetCurrentVideoDriver());
+
+        // Nothing is presented, so there is nothing to wait for
+        if (vsync)
+            printf("Headless: -vsync ignored\n");
+
+        vsync = 0;
+    }
+
+#ifdef EXAMPLE_HOST
+    run_examples(&options, window, context, framebuffer, width, height, vsync);
+#else
+    run(&options, window, context, framebuffer, width, height, vsync);
+#endif
+
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+
     SDL_GL_DeleteContext(context);
     SDL_DestroyWindow(window);
     SDL_Quit();
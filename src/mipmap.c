@@ -0,0 +1,596 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "mipmap.h"
+#include "targa.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MIPMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define MIP_CACHE_MAGIC 0x5350494d // "MIPS"
+#define MIP_CACHE_VERSION 1
+#define MIP_CACHE_EXTENSION ".mips"
+
+#define LINEAR_BITS 14 // four linear samples still sum up in 16 bits
+#define LINEAR_MAX ((1 << LINEAR_BITS) - 1)
+
+#define MAX_MIPMAP_THREADS 16
+
+struct mip_cache_header
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    source_hash;
+    uint32_t    iformat;
+    uint32_t    format;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    channels;
+    uint32_t    levels;
+    uint32_t    srgb;
+    uint32_t    padding;
+    uint64_t    size;
+};
+
+static uint16_t srgb_to_linear[256];
+static uint8_t linear_to_srgb[LINEAR_MAX + 1];
+static SDL_atomic_t luts_state;     // 0 - empty, 1 - being built, 2 - ready
+
+static void init_luts(void)
+{
+    if(SDL_AtomicCAS(&luts_state, 0, 1))
+    {
+        for(int i = 0; i < 256; i++)
+        {
+            const double c = i / 255.0;
+            const double l = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+
+            srgb_to_linear[i] = (uint16_t)(l * LINEAR_MAX + 0.5);
+        }
+
+        for(int i = 0; i <= LINEAR_MAX; i++)
+        {
+            const double l = (double)i / LINEAR_MAX;
+            const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+
+            linear_to_srgb[i] = (uint8_t)(c * 255.0 + 0.5);
+        }
+
+        SDL_AtomicSet(&luts_state, 2);
+    }
+
+    while(SDL_AtomicGet(&luts_state) != 2)
+        ;
+}
+
+extern int mip_levels_count(GLsizei width, GLsizei height)
+{
+    int levels = 1;
+
+    while(((width > 1) || (height > 1)) && (levels < MIP_MAX_LEVELS))
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+// Sums two rows into 16 bit values
+static void add_rows(const uint8_t *a, const uint8_t *b, uint16_t *sum, int count)
+{
+    int i = 0;
+
+#ifdef MIPMAP_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; i + 16 <= count; i += 16)
+    {
+        const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+
+        _mm_storeu_si128((__m128i*)(sum + i), _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+        _mm_storeu_si128((__m128i*)(sum + i + 8), _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+    }
+#endif
+
+    for(; i < count; i++)
+        sum[i] = a[i] + b[i];
+}
+
+// Averages horizontal pairs of summed pixels into the destination row
+static void reduce_row(const uint16_t *sum, uint8_t *dst, int src_width, int dst_width, int channels)
+{
+    const int step = src_width > 1 ? channels : 0;
+    int x = 0;
+
+#ifdef MIPMAP_SSE2
+    if((channels == 4) && step)
+    {
+        const __m128i two = _mm_set1_epi16(2);
+
+        for(; x + 4 <= dst_width; x += 4)
+        {
+            // each register holds two summed pixels, pair them up across registers
+            const __m128i s0 = _mm_loadu_si128((const __m128i*)(sum + x * 8));
+            const __m128i s1 = _mm_loadu_si128((const __m128i*)(sum + x * 8 + 8));
+            const __m128i s2 = _mm_loadu_si128((const __m128i*)(sum + x * 8 + 16));
+            const __m128i s3 = _mm_loadu_si128((const __m128i*)(sum + x * 8 + 24));
+
+            const __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+            const __m128i p23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+            const __m128i r01 = _mm_srli_epi16(_mm_add_epi16(p01, two), 2);
+            const __m128i r23 = _mm_srli_epi16(_mm_add_epi16(p23, two), 2);
+
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(r01, r23));
+        }
+    }
+#endif
+
+    for(; x < dst_width; x++)
+    {
+        const uint16_t *s = sum + x * 2 * channels;
+
+        for(int c = 0; c < channels; c++)
+            dst[x * channels + c] = (uint8_t)((s[c] + s[c + step] + 2) >> 2);
+    }
+}
+
+static void downsample(const uint8_t *src, int src_width, int src_height, uint8_t *dst, int dst_width, int dst_height, int channels, uint16_t *sum)
+{
+    const size_t src_stride = (size_t)src_width * channels;
+    const size_t dst_stride = (size_t)dst_width * channels;
+
+    for(int y = 0; y < dst_height; y++)
+    {
+        const uint8_t *a = src + src_stride * (src_height > 1 ? 2 * y : 0);
+        const uint8_t *b = src_height > 1 ? a + src_stride : a;
+
+        add_rows(a, b, sum, (int)src_stride);
+        reduce_row(sum, dst + dst_stride * y, src_width, dst_width, channels);
+    }
+}
+
+// Looks pixels up into linear space, alpha is only scaled to the same range
+static inline void linearize_pixels(const uint8_t *src, uint16_t *dst, int width, int channels)
+{
+    const int colors = channels == 4 ? 3 : channels;
+
+    for(int x = 0; x < width; x++, src += channels, dst += channels)
+    {
+        for(int c = 0; c < colors; c++)
+            dst[c] = srgb_to_linear[src[c]];
+
+        if(channels == 4)
+            dst[3] = (uint16_t)(src[3] << (LINEAR_BITS - 8));
+    }
+}
+
+// The lookups are the bulk of the work, with a constant channel count they unroll
+static void linearize_row(const uint8_t *src, uint16_t *dst, int width, int channels)
+{
+    if(channels == 3)
+        linearize_pixels(src, dst, width, 3);
+    else if(channels == 4)
+        linearize_pixels(src, dst, width, 4);
+    else
+        linearize_pixels(src, dst, width, channels);
+}
+
+// Sums two linear rows in place into a, at most 2 * LINEAR_MAX
+static void add_linear_rows(uint16_t *a, const uint16_t *b, int count)
+{
+    int i = 0;
+
+#ifdef MIPMAP_SSE2
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+
+        _mm_storeu_si128((__m128i*)(a + i), _mm_add_epi16(va, vb));
+    }
+#endif
+
+    for(; i < count; i++)
+        a[i] += b[i];
+}
+
+// Averages every value with the one a pixel to the right, whatever the channel count.
+// Only the even pixels of the result are used. Four samples of LINEAR_MAX plus the
+// rounding still fit in 16 bits.
+static void average_pairs(const uint16_t *sum, uint16_t *average, int count, int step)
+{
+    int i = 0;
+
+#ifdef MIPMAP_SSE2
+    const __m128i two = _mm_set1_epi16(2);
+
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i left = _mm_loadu_si128((const __m128i*)(sum + i));
+        const __m128i right = _mm_loadu_si128((const __m128i*)(sum + i + step));
+
+        _mm_storeu_si128((__m128i*)(average + i), _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(left, right), two), 2));
+    }
+#endif
+
+    for(; i < count; i++)
+        average[i] = (uint16_t)((sum[i] + sum[i + step] + 2) >> 2);
+}
+
+// Back to sRGB from the even pixels of the averaged row
+static inline void delinearize_pixels(const uint16_t *average, uint8_t *dst, int width, int channels)
+{
+    const int colors = channels == 4 ? 3 : channels;
+
+    for(int x = 0; x < width; x++, average += 2 * channels, dst += channels)
+    {
+        for(int c = 0; c < colors; c++)
+            dst[c] = linear_to_srgb[average[c]];
+
+        if(channels == 4)
+            dst[3] = (uint8_t)(average[3] >> (LINEAR_BITS - 8));
+    }
+}
+
+static void delinearize_row(const uint16_t *average, uint8_t *dst, int width, int channels)
+{
+    if(channels == 3)
+        delinearize_pixels(average, dst, width, 3);
+    else if(channels == 4)
+        delinearize_pixels(average, dst, width, 4);
+    else
+        delinearize_pixels(average, dst, width, channels);
+}
+
+// Same box filter in linear space, rows is scratch for two source rows
+static void downsample_srgb(const uint8_t *src, int src_width, int src_height, uint8_t *dst, int dst_width, int dst_height, int channels, uint16_t *rows)
+{
+    const size_t src_stride = (size_t)src_width * channels;
+    const size_t dst_stride = (size_t)dst_width * channels;
+    const int step = src_width > 1 ? channels : 0;
+    uint16_t *a = rows, *b = rows + src_stride;
+
+    for(int y = 0; y < dst_height; y++)
+    {
+        const uint8_t *row = src + src_stride * (src_height > 1 ? 2 * y : 0);
+
+        linearize_row(row, a, src_width, channels);
+        linearize_row(src_height > 1 ? row + src_stride : row, b, src_width, channels);
+
+        add_linear_rows(a, b, (int)src_stride);
+        // the last pixel of an odd row is never paired, nothing is read past the row
+        average_pairs(a, b, (int)src_stride - step, step);
+        delinearize_row(b, dst + dst_stride * y, dst_width, channels);
+    }
+}
+
+static size_t chain_size(const struct mip_chain *chain, size_t *offsets)
+{
+    GLsizei w = chain->width, h = chain->height;
+    size_t size = 0;
+
+    for(int level = 0; level < chain->levels; level++)
+    {
+        if(offsets)
+            offsets[level] = size;
+
+        size += (size_t)w * h * chain->channels;
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    return size;
+}
+
+static int alloc_chain(struct mip_chain *chain)
+{
+    size_t offsets[MIP_MAX_LEVELS];
+
+    chain->size = chain_size(chain, offsets);
+    chain->data = (uint8_t*)malloc(chain->size);
+
+    if(!chain->data)
+        return 0;
+
+    for(int level = 0; level < chain->levels; level++)
+        chain->pixels[level] = chain->data + offsets[level];
+
+    return 1;
+}
+
+extern int build_mip_chain(const void *pixels, GLsizei width, GLsizei height, int channels, int levels, int srgb, struct mip_chain *chain)
+{
+    memset(chain, 0, sizeof(*chain));
+
+    const int max_levels = mip_levels_count(width, height);
+
+    chain->width = width;
+    chain->height = height;
+    chain->channels = channels;
+    chain->levels = (levels > 0) && (levels < max_levels) ? levels : max_levels;
+
+    if(!alloc_chain(chain))
+        return 0;
+
+    if(srgb)
+        init_luts();
+
+    // two rows for the sRGB filter, one for the other
+    uint16_t *sum = (uint16_t*)malloc((size_t)width * channels * sizeof(uint16_t) * 2 + 16);
+
+    if(!sum)
+    {
+        free_mip_chain(chain);
+        return 0;
+    }
+
+    memcpy(chain->pixels[0], pixels, (size_t)width * height * channels);
+
+    GLsizei w = width, h = height;
+
+    for(int level = 1; level < chain->levels; level++)
+    {
+        const GLsizei dw = w > 1 ? w / 2 : 1;
+        const GLsizei dh = h > 1 ? h / 2 : 1;
+
+        if(srgb)
+            downsample_srgb(chain->pixels[level - 1], w, h, chain->pixels[level], dw, dh, channels, sum);
+        else
+            downsample(chain->pixels[level - 1], w, h, chain->pixels[level], dw, dh, channels, sum);
+
+        w = dw;
+        h = dh;
+    }
+
+    free(sum);
+
+    return 1;
+}
+
+extern void free_mip_chain(struct mip_chain *chain)
+{
+    free(chain->data);
+    memset(chain, 0, sizeof(*chain));
+}
+
+static int hash_file(const char *filepath, uint64_t *hash)
+{
+    struct vfs_view file;
+
+    if(!vfs_open(filepath, &file))
+        return 0;
+
+    // FNV-1a over 64 bit words of 8 KiB blocks, the tail is zero padded
+    const uint8_t *data = (const uint8_t*)file.data;
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for(size_t offset = 0; offset < file.size; offset += 8192)
+    {
+        const size_t read = file.size - offset < 8192 ? file.size - offset : 8192;
+
+        for(size_t i = 0; i < read; i += 8)
+        {
+            uint64_t word = 0;
+
+            memcpy(&word, data + offset + i, read - i < 8 ? read - i : 8);
+
+            h ^= word;
+            h *= 0x100000001b3ull;
+        }
+
+        h ^= read;
+    }
+
+    vfs_close(&file);
+
+    *hash = h;
+
+    return 1;
+}
+
+static char* cache_path(const char *filepath)
+{
+    char *path = (char*)malloc(strlen(filepath) + sizeof(MIP_CACHE_EXTENSION));
+
+    if(path)
+    {
+        strcpy(path, filepath);
+        strcat(path, MIP_CACHE_EXTENSION);
+    }
+
+    return path;
+}
+
+static int read_mip_cache(const char *path, uint64_t hash, int levels, int srgb, struct mip_chain *chain)
+{
+    struct vfs_view file;
+
+    if(!vfs_open(path, &file))
+        return 0;
+
+    struct mip_cache_header header;
+    int loaded = 0;
+
+    if(file.size >= sizeof(header))
+        memcpy(&header, file.data, sizeof(header));
+    else
+        header.magic = 0;
+
+    if((header.magic == MIP_CACHE_MAGIC) && (header.version == MIP_CACHE_VERSION) &&
+       (header.source_hash == hash) && (header.srgb == (uint32_t)srgb) && (header.levels <= MIP_MAX_LEVELS))
+    {
+        const int max_levels = mip_levels_count(header.width, header.height);
+        const int wanted_levels = (levels > 0) && (levels < max_levels) ? levels : max_levels;
+
+        memset(chain, 0, sizeof(*chain));
+
+        chain->iformat = header.iformat;
+        chain->format = header.format;
+        chain->width = header.width;
+        chain->height = header.height;
+        chain->channels = header.channels;
+        chain->levels = header.levels;
+
+        if((header.levels == (uint32_t)wanted_levels) && (chain_size(chain, NULL) == header.size) &&
+           (header.size <= file.size - sizeof(header)) && alloc_chain(chain))
+        {
+            memcpy(chain->data, (const uint8_t*)file.data + sizeof(header), chain->size);
+            loaded = 1;
+        }
+    }
+
+    vfs_close(&file);
+
+    return loaded;
+}
+
+static void write_mip_cache(const char *path, uint64_t hash, int srgb, const struct mip_chain *chain)
+{
+    FILE *fp = fopen(path, "wb");
+
+    // A missing cache only costs time, so a read-only asset directory is fine
+    if(!fp)
+        return;
+
+    struct mip_cache_header header = {0};
+
+    header.magic = MIP_CACHE_MAGIC;
+    header.version = MIP_CACHE_VERSION;
+    header.source_hash = hash;
+    header.iformat = chain->iformat;
+    header.format = chain->format;
+    header.width = chain->width;
+    header.height = chain->height;
+    header.channels = chain->channels;
+    header.levels = chain->levels;
+    header.srgb = srgb;
+    header.size = chain->size;
+
+    const int written = fwrite(&header, sizeof(header), 1, fp) && (fwrite(chain->data, 1, chain->size, fp) == chain->size);
+
+    fclose(fp);
+
+    if(!written)
+        remove(path);
+}
+
+static int channels_count(GLuint iformat)
+{
+    switch(iformat)
+    {
+    case GL_R8:
+        return 1;
+    case GL_RGB8:
+        return 3;
+    case GL_RGBA8:
+        return 4;
+    }
+
+    return 0;
+}
+
+extern int load_mip_chain(const char *filepath, int levels, int srgb, struct mip_chain *chain)
+{
+    memset(chain, 0, sizeof(*chain));
+
+    uint64_t hash;
+    char *path = cache_path(filepath);
+
+    if(!path || !hash_file(filepath, &hash))
+    {
+        free(path);
+        return 0;
+    }
+
+    if(read_mip_cache(path, hash, levels, srgb, chain))
+    {
+        free(path);
+        return 1;
+    }
+
+    struct targa_image image;
+    int built = 0;
+
+    if(map_targa(filepath, &image) && channels_count(image.iformat))
+    {
+        built = build_mip_chain(image.pixels, image.width, image.height, channels_count(image.iformat), levels, srgb, chain);
+
+        chain->iformat = image.iformat;
+        chain->format = image.format;
+
+        if(built)
+            write_mip_cache(path, hash, srgb, chain);
+    }
+
+    unmap_targa(&image);
+    free(path);
+
+    return built;
+}
+
+struct mip_chains_job
+{
+    const char        **filepaths;
+    int                 count;
+    int                 levels;
+    int                 srgb;
+    struct mip_chain   *chains;
+
+    SDL_atomic_t        next;
+    SDL_atomic_t        loaded;
+};
+
+static int mip_chains_thread(void *data)
+{
+    struct mip_chains_job *job = (struct mip_chains_job*)data;
+    int index;
+
+    while((index = SDL_AtomicAdd(&job->next, 1)) < job->count)
+        if(load_mip_chain(job->filepaths[index], job->levels, job->srgb, &job->chains[index]))
+            SDL_AtomicAdd(&job->loaded, 1);
+
+    return 0;
+}
+
+extern int load_mip_chains(const char **filepaths, int count, int levels, int srgb, struct mip_chain *chains)
+{
+    struct mip_chains_job job = {0};
+
+    job.filepaths = filepaths;
+    job.count = count;
+    job.levels = levels;
+    job.srgb = srgb;
+    job.chains = chains;
+
+    int threads_count = SDL_GetCPUCount();
+
+    if(threads_count > count)
+        threads_count = count;
+
+    if(threads_count > MAX_MIPMAP_THREADS)
+        threads_count = MAX_MIPMAP_THREADS;
+
+    SDL_Thread *threads[MAX_MIPMAP_THREADS] = {0};
+
+    for(int i = 0; i < threads_count; i++)
+        threads[i] = SDL_CreateThread(mip_chains_thread, "mipmap", &job);
+
+    // also helps out, and does all the work if no thread could be started
+    mip_chains_thread(&job);
+
+    for(int i = 0; i < threads_count; i++)
+        if(threads[i])
+            SDL_WaitThread(threads[i], NULL);
+
+    return SDL_AtomicGet(&job.loaded);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIP_MAX_LEVELS 16
+
+struct mip_chain
+{
+    GLuint      iformat;
+    GLenum      format;
+    GLsizei     width;              // of the base level
+    GLsizei     height;
+    int         channels;
+    int         levels;
+
+    uint8_t    *pixels[MIP_MAX_LEVELS];     // tightly packed levels, all inside data
+    uint8_t    *data;
+    size_t      size;
+};
+
+int mip_levels_count(GLsizei width, GLsizei height);
+
+// Builds up to levels levels with a 2x2 box filter. With srgb set colour channels
+// are averaged in linear space, alpha always is.
+int build_mip_chain(const void *pixels, GLsizei width, GLsizei height, int channels, int levels, int srgb, struct mip_chain *chain);
+void free_mip_chain(struct mip_chain *chain);
+
+// Loads the chain from the cache file next to the TGA if it was built from the same
+// file contents, otherwise decodes the TGA, builds the chain and writes the cache.
+int load_mip_chain(const char *filepath, int levels, int srgb, struct mip_chain *chain);
+// Same for several files on a pool of threads. Returns the number of loaded chains.
+int load_mip_chains(const char **filepaths, int count, int levels, int srgb, struct mip_chain *chains);
+
+#ifdef __cplusplus
+}
+#endif
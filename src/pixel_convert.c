@@ -0,0 +1,152 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "pixel_convert.h"
+
+// Every kernel converts back to front in whole blocks that are loaded before they
+// are stored. An expanded pixel never lands on source pixels before it, which makes
+// in-place expansion safe, and no kernel reads past the end of the source.
+
+static void bgr_to_rgba_scalar(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    for(size_t i = count; i-- > 0;)
+    {
+        const uint8_t b = src[i * 3 + 0], g = src[i * 3 + 1], r = src[i * 3 + 2];
+
+        dst[i * 4 + 0] = r;
+        dst[i * 4 + 1] = g;
+        dst[i * 4 + 2] = b;
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+static void bgra_to_rgba_scalar(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    for(size_t i = count; i-- > 0;)
+    {
+        const uint8_t b = src[i * 4 + 0], g = src[i * 4 + 1], r = src[i * 4 + 2], a = src[i * 4 + 3];
+
+        dst[i * 4 + 0] = r;
+        dst[i * 4 + 1] = g;
+        dst[i * 4 + 2] = b;
+        dst[i * 4 + 3] = a;
+    }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CONVERT_SIMD 1
+
+#include <immintrin.h>
+
+// Four BGR pixels in the low 12 bytes to RGBA, alpha comes from the OR mask
+#define BGR_TO_RGBA_SHUFFLE 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+#define BGRA_TO_RGBA_SHUFFLE 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+
+__attribute__((target("ssse3")))
+static void bgr_to_rgba_ssse3(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(BGR_TO_RGBA_SHUFFLE);
+    const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+    const size_t blocks = count / 16;
+
+    bgr_to_rgba_scalar(src + blocks * 48, dst + blocks * 64, count - blocks * 16);
+
+    for(size_t i = blocks; i-- > 0;)
+    {
+        const uint8_t *s = src + i * 48;
+        uint8_t *d = dst + i * 64;
+
+        const __m128i in0 = _mm_loadu_si128((const __m128i*)(s + 0));
+        const __m128i in1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        const __m128i in2 = _mm_loadu_si128((const __m128i*)(s + 32));
+
+        const __m128i p0 = in0;                             // bytes 0..11
+        const __m128i p1 = _mm_alignr_epi8(in1, in0, 12);   // bytes 12..23
+        const __m128i p2 = _mm_alignr_epi8(in2, in1, 8);    // bytes 24..35
+        const __m128i p3 = _mm_srli_si128(in2, 4);          // bytes 36..47
+
+        _mm_storeu_si128((__m128i*)(d + 0), _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), alpha));
+        _mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), alpha));
+        _mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), alpha));
+        _mm_storeu_si128((__m128i*)(d + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), alpha));
+    }
+}
+
+__attribute__((target("ssse3")))
+static void bgra_to_rgba_ssse3(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(BGRA_TO_RGBA_SHUFFLE);
+    const size_t blocks = count / 4;
+
+    bgra_to_rgba_scalar(src + blocks * 16, dst + blocks * 16, count - blocks * 4);
+
+    for(size_t i = blocks; i-- > 0;)
+        _mm_storeu_si128((__m128i*)(dst + i * 16), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 16)), shuffle));
+}
+
+// vpshufb works within 128 bit lanes, so each lane gets its own four pixels
+__attribute__((target("avx2")))
+static void bgr_to_rgba_avx2(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(BGR_TO_RGBA_SHUFFLE, BGR_TO_RGBA_SHUFFLE);
+    const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+    const size_t blocks = count / 16;
+
+    bgr_to_rgba_ssse3(src + blocks * 48, dst + blocks * 64, count - blocks * 16);
+
+    for(size_t i = blocks; i-- > 0;)
+    {
+        const uint8_t *s = src + i * 48;
+        uint8_t *d = dst + i * 64;
+
+        // the high lanes load 4 bytes early to stay inside the block
+        const __m256i in0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(s + 0))),
+                                                    _mm_loadu_si128((const __m128i*)(s + 8)), 1);
+        const __m256i in1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(s + 24))),
+                                                    _mm_loadu_si128((const __m128i*)(s + 32)), 1);
+
+        const __m256i p0 = _mm256_blend_epi32(in0, _mm256_srli_si256(in0, 4), 0xf0);
+        const __m256i p1 = _mm256_blend_epi32(in1, _mm256_srli_si256(in1, 4), 0xf0);
+
+        _mm256_storeu_si256((__m256i*)(d + 0), _mm256_or_si256(_mm256_shuffle_epi8(p0, shuffle), alpha));
+        _mm256_storeu_si256((__m256i*)(d + 32), _mm256_or_si256(_mm256_shuffle_epi8(p1, shuffle), alpha));
+    }
+}
+
+__attribute__((target("avx2")))
+static void bgra_to_rgba_avx2(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(BGRA_TO_RGBA_SHUFFLE, BGRA_TO_RGBA_SHUFFLE);
+    const size_t blocks = count / 8;
+
+    bgra_to_rgba_ssse3(src + blocks * 32, dst + blocks * 32, count - blocks * 8);
+
+    for(size_t i = blocks; i-- > 0;)
+        _mm256_storeu_si256((__m256i*)(dst + i * 32), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i * 32)), shuffle));
+}
+#endif
+
+typedef void (*convert_func)(const uint8_t *src, uint8_t *dst, size_t count);
+
+static convert_func select_convert(GLenum format)
+{
+#ifdef CONVERT_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return format == GL_BGR ? bgr_to_rgba_avx2 : bgra_to_rgba_avx2;
+
+    if(__builtin_cpu_supports("ssse3"))
+        return format == GL_BGR ? bgr_to_rgba_ssse3 : bgra_to_rgba_ssse3;
+#endif
+
+    return format == GL_BGR ? bgr_to_rgba_scalar : bgra_to_rgba_scalar;
+}
+
+extern GLenum convert_to_rgba8(const void *src, void *dst, size_t count, GLenum format)
+{
+    if((format != GL_BGR) && (format != GL_BGRA))
+        return 0;
+
+    select_convert(format)((const uint8_t*)src, (uint8_t*)dst, count);
+
+    return GL_RGBA;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Expands GL_BGR to RGBA with opaque alpha or swizzles GL_BGRA to RGBA, so drivers
+// get their native 4 byte layout. dst holds count * 4 bytes and may be src itself,
+// which then must be large enough for the expanded pixels. Returns GL_RGBA, or 0
+// without touching dst for other formats.
+GLenum convert_to_rgba8(const void *src, void *dst, size_t count, GLenum format);
+
+#ifdef __cplusplus
+}
+#endif
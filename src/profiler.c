@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "profiler.h"
+
+struct profiler_zone
+{
+    const char *name;
+    int         gpu;
+    Uint64      start;          // of the open CPU sample
+
+    float      *samples;        // ms
+    size_t      samples_count;
+    size_t      samples_capacity;
+};
+
+struct profiler_event
+{
+    int         zone;
+    int         thread;         // index into threads, -1 for the GPU
+    double      start;          // us since profiler_init
+    double      duration;
+};
+
+struct profiler_gpu_frame
+{
+    GLuint      queries[PROFILER_MAX_GPU_ZONES * 2];
+    int         zones[PROFILER_MAX_GPU_ZONES];
+    int         count;
+};
+
+struct profiler
+{
+    int         enabled;
+    Uint64      start;
+    double      frequency;      // counter ticks per us
+    GLint64     gpu_start;      // GL_TIMESTAMP at start, ns
+
+    SDL_SpinLock lock;          // zones, events and threads are shared by the threads
+    struct profiler_zone zones[PROFILER_MAX_ZONES];
+    int         zones_count;
+
+    SDL_threadID threads[PROFILER_MAX_THREADS];
+    int         threads_count;
+
+    struct profiler_event *events;
+    size_t      events_count;
+    size_t      events_dropped;
+
+    struct profiler_gpu_frame gpu_frames[PROFILER_QUERY_FRAMES];
+    unsigned    frame;
+    size_t      gpu_dropped;    // zones whose queries weren't ready in time
+};
+
+static struct profiler profiler;
+
+static int find_zone(const char *name, int gpu)
+{
+    for(int i = 0; i < profiler.zones_count; i++)
+    {
+        const struct profiler_zone *zone = &profiler.zones[i];
+
+        if((zone->gpu == gpu) && ((zone->name == name) || !strcmp(zone->name, name)))
+            return i;
+    }
+
+    if(profiler.zones_count == PROFILER_MAX_ZONES)
+        return -1;
+
+    struct profiler_zone *zone = &profiler.zones[profiler.zones_count];
+
+    memset(zone, 0, sizeof(*zone));
+    zone->name = name;
+    zone->gpu = gpu;
+
+    return profiler.zones_count++;
+}
+
+static int find_thread(void)
+{
+    const SDL_threadID id = SDL_ThreadID();
+
+    for(int i = 0; i < profiler.threads_count; i++)
+    {
+        if(profiler.threads[i] == id)
+            return i;
+    }
+
+    if(profiler.threads_count == PROFILER_MAX_THREADS)
+        return PROFILER_MAX_THREADS - 1;
+
+    profiler.threads[profiler.threads_count] = id;
+
+    return profiler.threads_count++;
+}
+
+// Called with the lock held
+static void add_sample(int index, int thread, double start, double duration)
+{
+    struct profiler_zone *zone = &profiler.zones[index];
+
+    if(zone->samples_count == zone->samples_capacity)
+    {
+        const size_t capacity = zone->samples_capacity ? zone->samples_capacity * 2 : 1024;
+        float *samples = (float*)realloc(zone->samples, capacity * sizeof(float));
+
+        if(!samples)
+            return;
+
+        zone->samples = samples;
+        zone->samples_capacity = capacity;
+    }
+
+    zone->samples[zone->samples_count++] = (float)(duration / 1000.0);
+
+    if(profiler.events_count == PROFILER_MAX_EVENTS)
+    {
+        profiler.events_dropped++;
+        return;
+    }
+
+    struct profiler_event *event = &profiler.events[profiler.events_count++];
+
+    event->zone = index;
+    event->thread = thread;
+    event->start = start;
+    event->duration = duration;
+}
+
+static double counter_to_us(Uint64 counter)
+{
+    return (double)(counter - profiler.start) / profiler.frequency;
+}
+
+extern void profiler_init(void)
+{
+    profiler_shutdown();
+
+    profiler.events = (struct profiler_event*)malloc(PROFILER_MAX_EVENTS * sizeof(struct profiler_event));
+
+    if(!profiler.events)
+        return;
+
+    for(int i = 0; i < PROFILER_QUERY_FRAMES; i++)
+        glCreateQueries(GL_TIMESTAMP, PROFILER_MAX_GPU_ZONES * 2, profiler.gpu_frames[i].queries);
+
+    // GPU timestamps are mapped to the CPU timeline through this pair
+    glGetInteger64v(GL_TIMESTAMP, &profiler.gpu_start);
+    profiler.start = SDL_GetPerformanceCounter();
+    profiler.frequency = (double)SDL_GetPerformanceFrequency() / 1e6;
+    profiler.enabled = 1;
+}
+
+extern void profiler_shutdown(void)
+{
+    if(profiler.enabled)
+    {
+        for(int i = 0; i < PROFILER_QUERY_FRAMES; i++)
+            glDeleteQueries(PROFILER_MAX_GPU_ZONES * 2, profiler.gpu_frames[i].queries);
+    }
+
+    for(int i = 0; i < profiler.zones_count; i++)
+        free(profiler.zones[i].samples);
+
+    free(profiler.events);
+    memset(&profiler, 0, sizeof(profiler));
+}
+
+extern int profiler_begin(const char *name)
+{
+    if(!profiler.enabled)
+        return -1;
+
+    SDL_AtomicLock(&profiler.lock);
+    const int zone = find_zone(name, 0);
+    SDL_AtomicUnlock(&profiler.lock);
+
+    if(zone >= 0)
+        profiler.zones[zone].start = SDL_GetPerformanceCounter();
+
+    return zone;
+}
+
+extern void profiler_end(int zone)
+{
+    if(zone < 0)
+        return;
+
+    const Uint64 end = SDL_GetPerformanceCounter();
+    const double start = counter_to_us(profiler.zones[zone].start);
+
+    SDL_AtomicLock(&profiler.lock);
+    add_sample(zone, find_thread(), start, counter_to_us(end) - start);
+    SDL_AtomicUnlock(&profiler.lock);
+}
+
+extern int profiler_gpu_begin(const char *name)
+{
+    if(!profiler.enabled)
+        return -1;
+
+    struct profiler_gpu_frame *frame = &profiler.gpu_frames[profiler.frame % PROFILER_QUERY_FRAMES];
+
+    SDL_AtomicLock(&profiler.lock);
+    const int zone = find_zone(name, 1);
+    SDL_AtomicUnlock(&profiler.lock);
+
+    if((zone < 0) || (frame->count == PROFILER_MAX_GPU_ZONES))
+        return -1;
+
+    const int index = frame->count++;
+
+    frame->zones[index] = zone;
+    glQueryCounter(frame->queries[index * 2], GL_TIMESTAMP);
+
+    return index;
+}
+
+extern void profiler_gpu_end(int zone)
+{
+    if(zone < 0)
+        return;
+
+    struct profiler_gpu_frame *frame = &profiler.gpu_frames[profiler.frame % PROFILER_QUERY_FRAMES];
+
+    glQueryCounter(frame->queries[zone * 2 + 1], GL_TIMESTAMP);
+}
+
+extern void profiler_frame(void)
+{
+    if(!profiler.enabled)
+        return;
+
+    profiler.frame++;
+
+    // The slot about to be reused holds the oldest frame in flight
+    struct profiler_gpu_frame *frame = &profiler.gpu_frames[profiler.frame % PROFILER_QUERY_FRAMES];
+
+    for(int i = 0; i < frame->count; i++)
+    {
+        GLint available = 0;
+
+        // the end is written after the begin, so it's the one to check
+        glGetQueryObjectiv(frame->queries[i * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if(!available)
+        {
+            profiler.gpu_dropped++;
+            continue;
+        }
+
+        GLuint64 begin = 0, end = 0;
+
+        glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        SDL_AtomicLock(&profiler.lock);
+        add_sample(frame->zones[i], -1, (double)((GLint64)begin - profiler.gpu_start) / 1000.0, (double)(end - begin) / 1000.0);
+        SDL_AtomicUnlock(&profiler.lock);
+    }
+
+    frame->count = 0;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    const float x = *(const float*)a, y = *(const float*)b;
+
+    return (x > y) - (x < y);
+}
+
+extern void profiler_report(FILE *fp)
+{
+    if(!profiler.enabled)
+        return;
+
+    fprintf(fp, "%-24s %8s %10s %10s %10s %10s\n", "zone", "samples", "min ms", "avg ms", "p99 ms", "max ms");
+
+    for(int i = 0; i < profiler.zones_count; i++)
+    {
+        struct profiler_zone *zone = &profiler.zones[i];
+
+        if(!zone->samples_count)
+            continue;
+
+        // sorted in place, the order of the samples isn't needed anymore
+        qsort(zone->samples, zone->samples_count, sizeof(float), compare_samples);
+
+        double total = 0.0;
+
+        for(size_t k = 0; k < zone->samples_count; k++)
+            total += zone->samples[k];
+
+        const size_t p99 = (zone->samples_count * 99 + 99) / 100 - 1;
+
+        fprintf(fp, "%-4s%-20s %8zu %10.3f %10.3f %10.3f %10.3f\n", zone->gpu ? "gpu " : "cpu ", zone->name, zone->samples_count,
+                zone->samples[0], total / zone->samples_count, zone->samples[p99], zone->samples[zone->samples_count - 1]);
+    }
+
+    if(profiler.gpu_dropped || profiler.events_dropped)
+        fprintf(fp, "%zu GPU zones not ready in time, %zu events left out of the trace\n", profiler.gpu_dropped, profiler.events_dropped);
+}
+
+extern int profiler_write_trace(const char *path)
+{
+    if(!profiler.enabled)
+        return 0;
+
+    FILE *fp = fopen(path, "w");
+
+    if(!fp)
+        return 0;
+
+    // the GPU is tid 1, the threads follow in the order they first ended a zone
+    fprintf(fp, "{\"traceEvents\":[\n"
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+
+    for(int i = 0; i < profiler.threads_count; i++)
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU %d\"}}", i + 2, i);
+
+    for(size_t i = 0; i < profiler.events_count; i++)
+    {
+        const struct profiler_event *event = &profiler.events[i];
+        const struct profiler_zone *zone = &profiler.zones[event->zone];
+
+        fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                zone->name, event->thread + 2, event->start, event->duration);
+    }
+
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    return !fclose(fp);
+}
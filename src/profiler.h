@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdio.h>
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILER_MAX_ZONES 32
+#define PROFILER_MAX_GPU_ZONES 8        // per frame
+#define PROFILER_QUERY_FRAMES 4         // GPU zones are read back this many frames late
+#define PROFILER_MAX_EVENTS (1 << 20)   // kept for the trace, later ones are only counted
+#define PROFILER_MAX_THREADS 8          // shown apart in the trace
+
+// Zones are named by string literals, samples of the same name add up in one zone.
+// Everything is a no-op until profiler_init.
+void profiler_init(void);
+void profiler_shutdown(void);
+
+// CPU zones measure with the performance counter and can be used from any thread.
+// Zones may nest but a name can't be open twice at once.
+int profiler_begin(const char *name);
+void profiler_end(int zone);
+
+// GPU zones put GL_TIMESTAMP queries around the commands issued in between. They,
+// profiler_frame and profiler_init belong to the thread the context is current on.
+int profiler_gpu_begin(const char *name);
+void profiler_gpu_end(int zone);
+
+// Ends the frame and collects the GPU zones of PROFILER_QUERY_FRAMES frames ago,
+// a query that still isn't available then is dropped rather than waited for
+void profiler_frame(void);
+
+// Min, average, p99 and max per zone
+void profiler_report(FILE *fp);
+// Chrome trace event JSON, for chrome://tracing or Perfetto
+int profiler_write_trace(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
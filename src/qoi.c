@@ -0,0 +1,306 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qoi.h"
+#include "vfs.h"
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK_2 0xc0
+
+#define QOI_MAX_RUN 62
+
+union qoi_rgba
+{
+    struct
+    {
+        uint8_t r, g, b, a;
+    } c;
+    uint32_t    v;
+};
+
+static const uint8_t qoi_padding[QOI_PADDING_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+static int qoi_hash(union qoi_rgba px)
+{
+    return (px.c.r * 3 + px.c.g * 5 + px.c.b * 7 + px.c.a * 11) & 63;
+}
+
+static void write_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Inlined with a constant channel count, so each case gets its own loop
+static inline int decode_qoi_pixels(const uint8_t *src, const uint8_t *end, uint8_t *pixels, size_t width, size_t height, const int channels)
+{
+    union qoi_rgba index[64];
+    union qoi_rgba px;
+    int run = 0;
+
+    memset(index, 0, sizeof(index));
+    px.c.r = px.c.g = px.c.b = 0;
+    px.c.a = 255;
+
+    for(size_t y = height; y-- > 0;)
+    {
+        uint8_t *dst = pixels + y * width * channels;
+
+        for(size_t x = 0; x < width; x++, dst += channels)
+        {
+            if(run)
+                run--;
+            else
+            {
+                // The padding guarantees the operands of an op starting before end
+                if(src >= end)
+                    return 0;
+
+                const int b1 = *src++;
+
+                if(b1 == QOI_OP_RGB)
+                {
+                    px.c.r = src[0];
+                    px.c.g = src[1];
+                    px.c.b = src[2];
+                    src += 3;
+                }
+                else if(b1 == QOI_OP_RGBA)
+                {
+                    px.c.r = src[0];
+                    px.c.g = src[1];
+                    px.c.b = src[2];
+                    px.c.a = src[3];
+                    src += 4;
+                }
+                else
+                {
+                    switch(b1 & QOI_MASK_2)
+                    {
+                    case QOI_OP_INDEX:
+                        px = index[b1];
+                        break;
+                    case QOI_OP_DIFF:
+                        px.c.r += ((b1 >> 4) & 3) - 2;
+                        px.c.g += ((b1 >> 2) & 3) - 2;
+                        px.c.b += (b1 & 3) - 2;
+                        break;
+                    case QOI_OP_LUMA:
+                    {
+                        const int b2 = *src++;
+                        const int vg = (b1 & 0x3f) - 32;
+
+                        px.c.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                        px.c.g += vg;
+                        px.c.b += vg - 8 + (b2 & 0x0f);
+                        break;
+                    }
+                    case QOI_OP_RUN:
+                        run = b1 & 0x3f;
+                        break;
+                    }
+                }
+
+                index[qoi_hash(px)] = px;
+            }
+
+            dst[0] = px.c.r;
+            dst[1] = px.c.g;
+            dst[2] = px.c.b;
+
+            if(channels == 4)
+                dst[3] = px.c.a;
+        }
+    }
+
+    return 1;
+}
+
+extern void* decode_qoi(const void *data, size_t size, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height)
+{
+    const uint8_t *src = (const uint8_t*)data;
+
+    if((size < QOI_HEADER_SIZE + QOI_PADDING_SIZE) || (read_u32(src) != QOI_MAGIC))
+        return NULL;
+
+    const uint32_t w = read_u32(src + 4), h = read_u32(src + 8);
+    const int channels = src[12];
+
+    if(!w || !h || (w > QOI_MAX_PIXELS / h) || ((channels != 3) && (channels != 4)))
+        return NULL;
+
+    uint8_t *pixels = (uint8_t*)malloc((size_t)w * h * channels);
+
+    if(!pixels)
+        return NULL;
+
+    const uint8_t *end = src + size - QOI_PADDING_SIZE;
+    const int decoded = channels == 3 ? decode_qoi_pixels(src + QOI_HEADER_SIZE, end, pixels, w, h, 3) :
+                                        decode_qoi_pixels(src + QOI_HEADER_SIZE, end, pixels, w, h, 4);
+
+    if(!decoded)
+    {
+        free(pixels);
+        return NULL;
+    }
+
+    *iformat = channels == 3 ? GL_RGB8 : GL_RGBA8;
+    *format = channels == 3 ? GL_RGB : GL_RGBA;
+    *width = (GLsizei)w;
+    *height = (GLsizei)h;
+
+    return pixels;
+}
+
+extern void* load_qoi(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height)
+{
+    struct vfs_view file;
+
+    if(!vfs_open(filepath, &file))
+        return NULL;
+
+    void *pixels = decode_qoi(file.data, file.size, iformat, format, width, height);
+
+    vfs_close(&file);
+
+    return pixels;
+}
+
+extern void* encode_qoi(const void *pixels, GLsizei width, GLsizei height, GLenum format, size_t *size)
+{
+    int channels, r, b;
+
+    switch(format)
+    {
+    case GL_RGB:  channels = 3; r = 0; b = 2; break;
+    case GL_BGR:  channels = 3; r = 2; b = 0; break;
+    case GL_RGBA: channels = 4; r = 0; b = 2; break;
+    case GL_BGRA: channels = 4; r = 2; b = 0; break;
+    default:
+        return NULL;
+    }
+
+    if((width <= 0) || (height <= 0) || ((size_t)width > QOI_MAX_PIXELS / (size_t)height))
+        return NULL;
+
+    // Worst case every pixel is a full RGBA op
+    uint8_t *out = (uint8_t*)malloc(QOI_HEADER_SIZE + (size_t)width * height * (channels + 1) + QOI_PADDING_SIZE);
+
+    if(!out)
+        return NULL;
+
+    write_u32(out, QOI_MAGIC);
+    write_u32(out + 4, (uint32_t)width);
+    write_u32(out + 8, (uint32_t)height);
+    out[12] = (uint8_t)channels;
+    out[13] = 0;        // sRGB colour, linear alpha
+
+    union qoi_rgba index[64];
+    union qoi_rgba px, prev;
+    uint8_t *p = out + QOI_HEADER_SIZE;
+    int run = 0;
+
+    memset(index, 0, sizeof(index));
+    prev.c.r = prev.c.g = prev.c.b = 0;
+    prev.c.a = 255;
+    px = prev;
+
+    for(GLsizei y = height; y-- > 0;)
+    {
+        const uint8_t *src = (const uint8_t*)pixels + (size_t)y * width * channels;
+
+        for(GLsizei x = 0; x < width; x++, src += channels)
+        {
+            px.c.r = src[r];
+            px.c.g = src[1];
+            px.c.b = src[b];
+            px.c.a = channels == 4 ? src[3] : 255;
+
+            if(px.v == prev.v)
+            {
+                if(++run == QOI_MAX_RUN)
+                {
+                    *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+
+                continue;
+            }
+
+            if(run)
+            {
+                *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            const int h = qoi_hash(px);
+
+            if(index[h].v == px.v)
+                *p++ = (uint8_t)(QOI_OP_INDEX | h);
+            else
+            {
+                index[h] = px;
+
+                if(px.c.a == prev.c.a)
+                {
+                    const int8_t vr = (int8_t)(px.c.r - prev.c.r);
+                    const int8_t vg = (int8_t)(px.c.g - prev.c.g);
+                    const int8_t vb = (int8_t)(px.c.b - prev.c.b);
+                    const int8_t vg_r = (int8_t)(vr - vg);
+                    const int8_t vg_b = (int8_t)(vb - vg);
+
+                    if((vr > -3) && (vr < 2) && (vg > -3) && (vg < 2) && (vb > -3) && (vb < 2))
+                        *p++ = (uint8_t)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                    else if((vg_r > -9) && (vg_r < 8) && (vg > -33) && (vg < 32) && (vg_b > -9) && (vg_b < 8))
+                    {
+                        *p++ = (uint8_t)(QOI_OP_LUMA | (vg + 32));
+                        *p++ = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+                    }
+                    else
+                    {
+                        *p++ = QOI_OP_RGB;
+                        *p++ = px.c.r;
+                        *p++ = px.c.g;
+                        *p++ = px.c.b;
+                    }
+                }
+                else
+                {
+                    *p++ = QOI_OP_RGBA;
+                    *p++ = px.c.r;
+                    *p++ = px.c.g;
+                    *p++ = px.c.b;
+                    *p++ = px.c.a;
+                }
+            }
+
+            prev = px;
+        }
+    }
+
+    if(run)
+        *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+
+    memcpy(p, qoi_padding, QOI_PADDING_SIZE);
+    p += QOI_PADDING_SIZE;
+
+    *size = (size_t)(p - out);
+
+    // Gives back the worst case reserve
+    uint8_t *shrunk = (uint8_t*)realloc(out, *size);
+
+    return shrunk ? shrunk : out;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QOI_MAGIC 0x716f6966        // "qoif", big endian like the rest of the header
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+#define QOI_MAX_PIXELS 400000000
+
+// Files are stored top row first as the format defines, pixels in memory are in GL
+// order like TGA, bottom row first. 3 channel files decode to GL_RGB, 4 to GL_RGBA.
+void* load_qoi(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height);
+void* decode_qoi(const void *data, size_t size, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height);
+
+// Encodes GL_RGB, GL_BGR, GL_RGBA or GL_BGRA pixels. Returns the file, release with free.
+void* encode_qoi(const void *pixels, GLsizei width, GLsizei height, GLenum format, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+extern int spsc_ring_init(struct spsc_ring *ring, size_t size, unsigned capacity)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    unsigned count = 1;
+
+    while(count < capacity)
+        count <<= 1;
+
+    ring->stride = (size + SPSC_RING_PADDING - 1) & ~(size_t)(SPSC_RING_PADDING - 1);
+
+    if(!ring->stride)
+        ring->stride = SPSC_RING_PADDING;
+
+    ring->mask = count - 1;
+    ring->memory = (unsigned char*)calloc(count, ring->stride);
+
+    return ring->memory != NULL;
+}
+
+extern void spsc_ring_free(struct spsc_ring *ring)
+{
+    free(ring->memory);
+    memset(ring, 0, sizeof(*ring));
+}
+
+extern void* spsc_ring_reserve(struct spsc_ring *ring)
+{
+    const unsigned head = (unsigned)SDL_AtomicGet(&ring->head);
+
+    // indices run freely, they are only masked to address an element
+    if(head - (unsigned)SDL_AtomicGet(&ring->tail) > ring->mask)
+        return NULL;
+
+    return ring->memory + (head & ring->mask) * ring->stride;
+}
+
+extern void spsc_ring_push(struct spsc_ring *ring)
+{
+    // full barrier, the element is written before the consumer can see it
+    SDL_AtomicAdd(&ring->head, 1);
+}
+
+extern const void* spsc_ring_peek(struct spsc_ring *ring)
+{
+    const unsigned tail = (unsigned)SDL_AtomicGet(&ring->tail);
+
+    if(tail == (unsigned)SDL_AtomicGet(&ring->head))
+        return NULL;
+
+    return ring->memory + (tail & ring->mask) * ring->stride;
+}
+
+extern void spsc_ring_pop(struct spsc_ring *ring)
+{
+    SDL_AtomicAdd(&ring->tail, 1);
+}
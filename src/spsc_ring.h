@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <SDL2/SDL_atomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPSC_RING_PADDING 64
+
+// Fixed size elements passed from one producer thread to one consumer thread in
+// order. Each side only writes its own index, neither ever takes a lock.
+struct spsc_ring
+{
+    unsigned char *memory;
+    size_t      stride;
+    unsigned    mask;           // capacity - 1
+
+    SDL_atomic_t head;          // next to write, producer's
+    char        padding[SPSC_RING_PADDING];
+    SDL_atomic_t tail;          // next to read, consumer's
+};
+
+// Capacity is rounded up to a power of two
+int spsc_ring_init(struct spsc_ring *ring, size_t size, unsigned capacity);
+void spsc_ring_free(struct spsc_ring *ring);
+
+// Producer side, the element to fill or NULL when the ring is full. It's only
+// visible to the consumer after spsc_ring_push.
+void* spsc_ring_reserve(struct spsc_ring *ring);
+void spsc_ring_push(struct spsc_ring *ring);
+
+// Consumer side, the oldest element or NULL when the ring is empty. It stays
+// valid until spsc_ring_pop.
+const void* spsc_ring_peek(struct spsc_ring *ring);
+void spsc_ring_pop(struct spsc_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "staging_buffer.h"
+
+#define STAGING_ALIGNMENT 64
+#define STAGING_WAIT_TIMEOUT 1000000000ull // ns
+
+static const GLbitfield staging_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+extern int staging_buffer_init(struct staging_buffer *staging, size_t size)
+{
+    memset(staging, 0, sizeof(*staging));
+
+    glCreateBuffers(1, &staging->buffer);
+    glNamedBufferStorage(staging->buffer, size, NULL, staging_flags);
+
+    staging->memory = (uint8_t*)glMapNamedBufferRange(staging->buffer, 0, size, staging_flags);
+
+    if(!staging->memory)
+    {
+        glDeleteBuffers(1, &staging->buffer);
+        memset(staging, 0, sizeof(*staging));
+        return 0;
+    }
+
+    staging->size = size;
+
+    return 1;
+}
+
+extern void staging_buffer_free(struct staging_buffer *staging)
+{
+    for(int i = 0; i < staging->fences_count; i++)
+        glDeleteSync(staging->fences[(staging->fences_first + i) % STAGING_MAX_FENCES].sync);
+
+    if(staging->buffer)
+    {
+        glUnmapNamedBuffer(staging->buffer);
+        glDeleteBuffers(1, &staging->buffer);
+    }
+
+    memset(staging, 0, sizeof(*staging));
+}
+
+static void wait_oldest_fence(struct staging_buffer *staging)
+{
+    struct staging_fence *fence = &staging->fences[staging->fences_first];
+
+    while(glClientWaitSync(fence->sync, GL_SYNC_FLUSH_COMMANDS_BIT, STAGING_WAIT_TIMEOUT) == GL_TIMEOUT_EXPIRED)
+        ;
+
+    glDeleteSync(fence->sync);
+
+    staging->tail = fence->end;
+    staging->fences_first = (staging->fences_first + 1) % STAGING_MAX_FENCES;
+    staging->fences_count--;
+
+    if(!staging->fences_count && !staging->pending)
+        staging->head = staging->tail = 0;
+}
+
+// head == tail always means empty, so the free space never closes up completely
+static size_t find_space(const struct staging_buffer *staging, size_t size)
+{
+    const size_t offset = (staging->head + STAGING_ALIGNMENT - 1) & ~(size_t)(STAGING_ALIGNMENT - 1);
+
+    if(staging->head >= staging->tail)
+    {
+        if(offset + size <= staging->size)
+            return offset;
+
+        // wrap around, skipping the rest of the buffer
+        if(size < staging->tail)
+            return 0;
+    }
+    else if(offset + size < staging->tail)
+        return offset;
+
+    return STAGING_NO_SPACE;
+}
+
+extern size_t staging_buffer_alloc(struct staging_buffer *staging, size_t size, int wait)
+{
+    if(size >= staging->size)
+        return STAGING_NO_SPACE;
+
+    size_t offset;
+
+    while((offset = find_space(staging, size)) == STAGING_NO_SPACE)
+    {
+        if(!wait || !staging->fences_count)
+            return STAGING_NO_SPACE;
+
+        wait_oldest_fence(staging);
+    }
+
+    staging->head = offset + size;
+    staging->pending = 1;
+
+    return offset;
+}
+
+extern void staging_buffer_fence(struct staging_buffer *staging)
+{
+    if(!staging->pending)
+        return;
+
+    if(staging->fences_count == STAGING_MAX_FENCES)
+        wait_oldest_fence(staging);
+
+    struct staging_fence *fence = &staging->fences[(staging->fences_first + staging->fences_count) % STAGING_MAX_FENCES];
+
+    fence->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fence->end = staging->head;
+
+    staging->fences_count++;
+    staging->pending = 0;
+}
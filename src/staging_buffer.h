@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STAGING_MAX_FENCES 64
+#define STAGING_NO_SPACE ((size_t)-1)
+
+struct staging_fence
+{
+    GLsync      sync;
+    size_t      end;            // head of the ring when the fence was inserted
+};
+
+// Ring of persistently mapped pixel unpack memory. Regions are handed out at head
+// and given back when the fence inserted after the uploads reading them signals.
+struct staging_buffer
+{
+    GLuint      buffer;
+    uint8_t    *memory;
+    size_t      size;
+
+    size_t      head;
+    size_t      tail;
+    int         pending;        // allocations not covered by a fence yet
+
+    struct staging_fence fences[STAGING_MAX_FENCES];
+    int         fences_first;
+    int         fences_count;
+};
+
+// Returns 0 when the buffer can't be mapped, the ring is left empty
+int staging_buffer_init(struct staging_buffer *staging, size_t size);
+void staging_buffer_free(struct staging_buffer *staging);
+
+// Returns the offset of size free bytes or STAGING_NO_SPACE. With wait set it blocks
+// on the oldest fences until the region fits, otherwise it fails when the ring is full.
+size_t staging_buffer_alloc(struct staging_buffer *staging, size_t size, int wait);
+// Fences all allocations made so far, call after issuing the commands reading them
+void staging_buffer_fence(struct staging_buffer *staging);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,7 +3,7 @@
 #include <stdint.h>
 #include <string.h>
 
-#include <glcore_450.h>
+#include "targa.h"
 
 enum TARGA_DATA_TYPE
 {
@@ -35,86 +35,489 @@ struct tga_header
 };
 #pragma pack(pop, tga_header_align)
 
-void* load_targa(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height);
+static void targa_formats(uint8_t bpp, GLuint *iformat, GLenum *format)
+{
+    switch(bpp)
+    {
+    case 8:
+        *iformat = GL_R8;
+        *format = GL_RED;
+        break;
+    case 24:
+        *iformat = GL_RGB8;
+        *format = GL_BGR;
+        break;
+    case 32:
+        *iformat = GL_RGBA8;
+        *format = GL_BGRA;
+        break;
+    }
+}
 
-extern void* load_targa(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height)
+static size_t targa_pixels_offset(const struct tga_header *header)
 {
-    FILE *fp = fopen(filepath, "rb");
+    const size_t colormap_size = header->color_map ? (size_t)header->colormap_length * ((header->colormap_entry_size + 7) / 8) : 0;
 
-    if(!fp)
-        return NULL;
+    return sizeof(*header) + header->length + colormap_size;
+}
 
-    fseek(fp, 0, SEEK_END);
-    int lenght = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+static void fill_pixels_scalar(uint8_t *dst, const uint8_t *pixel, size_t bytesperpixel, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        memcpy(dst, pixel, bytesperpixel);
+        dst += bytesperpixel;
+    }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TARGA_SIMD 1
 
-    struct tga_header header = {0};
-    fread(&header, sizeof(header), 1, fp);
+#include <immintrin.h>
 
-    const uint8_t bytesperpixel = header.bpp / 8;
-    uint8_t *data = NULL;
+// SSE2 is part of x86-64, so these need no dispatch. Only whole vectors are stored,
+// the tail goes through the scalar path to never write past the end of the run.
+static void fill_pixels_sse2(uint8_t *dst, const uint8_t *pixel, size_t bytesperpixel, size_t count)
+{
+    const size_t size = bytesperpixel * count;
+    size_t i = 0;
 
-    if((header.data_type == TARGA_DATA_RLE_TRUE_COLOR) || (header.data_type == TARGA_DATA_RLE_BLACK_AND_WITE))
+    if(bytesperpixel == 3)
     {
-        data = (uint8_t*)malloc(header.width * header.height * (bytesperpixel + 1)); // todo : why +1??? it works
-        uint8_t *pdata = data;
+        // lcm(3, 16) = 48, so three registers hold a pattern of 16 whole pixels
+        uint8_t pattern[48];
+        fill_pixels_scalar(pattern, pixel, 3, 16);
 
-        uint8_t block = 0;
+        const __m128i p0 = _mm_loadu_si128((const __m128i*)(pattern + 0));
+        const __m128i p1 = _mm_loadu_si128((const __m128i*)(pattern + 16));
+        const __m128i p2 = _mm_loadu_si128((const __m128i*)(pattern + 32));
 
-        for(int i = 0; (i < header.width * header.height) && !feof(fp); i++)
+        for(; i + 48 <= size; i += 48)
         {
-            fread(&block, 1, 1, fp);
-
-            uint8_t count = (block & 0x7f) + 1;
-
-            if(block & 0x80)
-            {
-                uint8_t bytes[4] = {0};
-                fread(bytes, bytesperpixel, 1, fp);
-
-                for(int j = 0; j < count; j++)
-                {
-                    memcpy(pdata, bytes, bytesperpixel);
-                    pdata += bytesperpixel;
-                }
-            }
-            else
-            {
-                fread(pdata, bytesperpixel * count, 1, fp);
-                pdata += bytesperpixel * count;
-            }
+            _mm_storeu_si128((__m128i*)(dst + i + 0), p0);
+            _mm_storeu_si128((__m128i*)(dst + i + 16), p1);
+            _mm_storeu_si128((__m128i*)(dst + i + 32), p2);
         }
     }
-    else if((header.data_type == TARGA_DATA_TRUE_COLOR) || (header.data_type == TARGA_DATA_BLACK_AND_WHITE))
+    else
     {
-        data = (uint8_t*)malloc(header.width * header.height * (bytesperpixel + 1));
+        __m128i p;
 
-        if(!fread(data, lenght - sizeof(header), 1, fp))
+        if(bytesperpixel == 4)
+        {
+            int32_t value;
+            memcpy(&value, pixel, 4);
+            p = _mm_set1_epi32(value);
+        }
+        else if(bytesperpixel == 1)
+            p = _mm_set1_epi8((char)pixel[0]);
+        else
         {
-            fclose(fp);
+            fill_pixels_scalar(dst, pixel, bytesperpixel, count);
+            return;
         }
+
+        for(; i + 16 <= size; i += 16)
+            _mm_storeu_si128((__m128i*)(dst + i), p);
     }
 
-    fclose(fp);
+    fill_pixels_scalar(dst + i, pixel, bytesperpixel, (size - i) / bytesperpixel);
+}
+
+__attribute__((target("avx2")))
+static void fill_pixels_avx2(uint8_t *dst, const uint8_t *pixel, size_t bytesperpixel, size_t count)
+{
+    const size_t size = bytesperpixel * count;
+    size_t i = 0;
 
-    switch(header.bpp)
+    if(bytesperpixel == 3)
     {
-    case 8:
-        *iformat = GL_R8;
-        *format = GL_RED;
-        break;
-    case 24:
-        *iformat = GL_RGB8;
-        *format = GL_BGR;
-        break;
-    case 32:
-        *iformat = GL_RGBA8;
-        *format = GL_BGRA;
-        break;
+        uint8_t pattern[96];
+        fill_pixels_scalar(pattern, pixel, 3, 32);
+
+        const __m256i p0 = _mm256_loadu_si256((const __m256i*)(pattern + 0));
+        const __m256i p1 = _mm256_loadu_si256((const __m256i*)(pattern + 32));
+        const __m256i p2 = _mm256_loadu_si256((const __m256i*)(pattern + 64));
+
+        for(; i + 96 <= size; i += 96)
+        {
+            _mm256_storeu_si256((__m256i*)(dst + i + 0), p0);
+            _mm256_storeu_si256((__m256i*)(dst + i + 32), p1);
+            _mm256_storeu_si256((__m256i*)(dst + i + 64), p2);
+        }
     }
+    else
+    {
+        __m256i p;
+
+        if(bytesperpixel == 4)
+        {
+            int32_t value;
+            memcpy(&value, pixel, 4);
+            p = _mm256_set1_epi32(value);
+        }
+        else if(bytesperpixel == 1)
+            p = _mm256_set1_epi8((char)pixel[0]);
+        else
+        {
+            fill_pixels_scalar(dst, pixel, bytesperpixel, count);
+            return;
+        }
+
+        for(; i + 32 <= size; i += 32)
+            _mm256_storeu_si256((__m256i*)(dst + i), p);
+    }
+
+    fill_pixels_sse2(dst + i, pixel, bytesperpixel, (size - i) / bytesperpixel);
+}
+#endif
+
+typedef void (*fill_pixels_func)(uint8_t *dst, const uint8_t *pixel, size_t bytesperpixel, size_t count);
+
+static fill_pixels_func select_fill_pixels(void)
+{
+#ifdef TARGA_SIMD
+    if(__builtin_cpu_supports("avx2"))
+        return fill_pixels_avx2;
+
+    return fill_pixels_sse2;
+#else
+    return fill_pixels_scalar;
+#endif
+}
+
+struct targa_rle_stream
+{
+    const uint8_t *src;
+    const uint8_t *end;
+    size_t      bytesperpixel;
+    size_t      count;              // pixels left in the current packet
+    int         run;                // the current packet repeats one pixel
+    fill_pixels_func fill_pixels;
+};
+
+static void init_targa_rle(struct targa_rle_stream *stream, const uint8_t *src, size_t src_size, size_t bytesperpixel)
+{
+    memset(stream, 0, sizeof(*stream));
+
+    stream->src = src;
+    stream->end = src + src_size;
+    stream->bytesperpixel = bytesperpixel;
+    stream->fill_pixels = select_fill_pixels();
+}
+
+// Decodes exactly pixels_count pixels into dst, a packet cut off by the previous
+// call is continued. Returns 0 if src ends early.
+static int decode_targa_rle_stream(struct targa_rle_stream *stream, uint8_t *dst, size_t pixels_count)
+{
+    const size_t bytesperpixel = stream->bytesperpixel;
+
+    while(pixels_count > 0)
+    {
+        if(!stream->count)
+        {
+            if(stream->src == stream->end)
+                return 0;
+
+            const uint8_t block = *stream->src++;
+
+            stream->count = (block & 0x7f) + 1;
+            stream->run = block & 0x80;
+
+            if(stream->run && ((size_t)(stream->end - stream->src) < bytesperpixel))
+                return 0;
+        }
+
+        const size_t count = stream->count < pixels_count ? stream->count : pixels_count;
+
+        if(stream->run)
+        {
+            stream->fill_pixels(dst, stream->src, bytesperpixel, count);
+
+            // the repeated pixel is consumed with the last of the run
+            if(count == stream->count)
+                stream->src += bytesperpixel;
+        }
+        else
+        {
+            if((size_t)(stream->end - stream->src) < bytesperpixel * count)
+                return 0;
+
+            memcpy(dst, stream->src, bytesperpixel * count);
+            stream->src += bytesperpixel * count;
+        }
+
+        stream->count -= count;
+        dst += bytesperpixel * count;
+        pixels_count -= count;
+    }
+
+    return 1;
+}
+
+// Decodes exactly pixels_count pixels into dst. Returns 0 if src ends early.
+static int decode_targa_rle(const uint8_t *src, size_t src_size, uint8_t *dst, size_t pixels_count, size_t bytesperpixel)
+{
+    struct targa_rle_stream stream;
+
+    init_targa_rle(&stream, src, src_size, bytesperpixel);
+
+    return decode_targa_rle_stream(&stream, dst, pixels_count);
+}
+
+static int is_targa_rle(const struct tga_header *header)
+{
+    return (header->data_type == TARGA_DATA_RLE_TRUE_COLOR) || (header->data_type == TARGA_DATA_RLE_BLACK_AND_WITE);
+}
+
+static int is_targa_raw(const struct tga_header *header)
+{
+    return (header->data_type == TARGA_DATA_TRUE_COLOR) || (header->data_type == TARGA_DATA_BLACK_AND_WHITE);
+}
+
+// Checks that the image can be decoded from size bytes
+static int parse_targa(const uint8_t *data, size_t size, struct tga_header *header)
+{
+    if(size < sizeof(*header))
+        return 0;
+
+    memcpy(header, data, sizeof(*header));
+
+    // targa_formats and every size below only know whole byte depths
+    if((header->bpp != 8) && (header->bpp != 24) && (header->bpp != 32))
+        return 0;
+
+    const size_t offset = targa_pixels_offset(header);
+    const size_t pixels_size = (size_t)header->width * header->height * (header->bpp / 8);
+
+    if(offset > size)
+        return 0;
 
-    *width = header.width;
-    *height = header.height;
+    if(is_targa_rle(header))
+        return 1;
+
+    return is_targa_raw(header) && (pixels_size <= size - offset);
+}
+
+static int decode_targa_pixels(const uint8_t *data, size_t size, const struct tga_header *header, uint8_t *pixels)
+{
+    const size_t offset = targa_pixels_offset(header);
+    const size_t bytesperpixel = header->bpp / 8;
+    const size_t pixels_count = (size_t)header->width * header->height;
+
+    if(is_targa_rle(header))
+        return decode_targa_rle(data + offset, size - offset, pixels, pixels_count, bytesperpixel);
+
+    memcpy(pixels, data + offset, pixels_count * bytesperpixel);
+
+    return 1;
+}
+
+static void* view_targa(const uint8_t *data, size_t size, struct targa_image *image)
+{
+    struct tga_header header;
+
+    if(!parse_targa(data, size, &header))
+        return NULL;
+
+    targa_formats(header.bpp, &image->iformat, &image->format);
+
+    image->width = header.width;
+    image->height = header.height;
+
+    if(is_targa_raw(&header))
+    {
+        image->pixels = (void*)(uintptr_t)(data + targa_pixels_offset(&header)); // pixels stay read-only
+        return image->pixels;
+    }
+
+    image->buffer = malloc((size_t)header.width * header.height * (header.bpp / 8));
+
+    if(image->buffer && !decode_targa_pixels(data, size, &header, (uint8_t*)image->buffer))
+    {
+        free(image->buffer);
+        image->buffer = NULL;
+    }
+
+    image->pixels = image->buffer;
+
+    return image->pixels;
+}
+
+extern void* load_targa(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height)
+{
+    struct targa_image image;
+
+    if(!map_targa(filepath, &image))
+        return NULL;
+
+    void *data = image.buffer;
+
+    // Views into the file are copied, decoded images are handed over as they are
+    if(data)
+        image.buffer = NULL;
+    else
+    {
+        // the view is still open, its header was checked by map_targa
+        struct tga_header header;
+
+        memcpy(&header, image.file.data, sizeof(header));
+
+        const size_t size = (size_t)image.width * image.height * (header.bpp / 8);
+
+        data = malloc(size);
+
+        if(data)
+            memcpy(data, image.pixels, size);
+    }
+
+    *iformat = image.iformat;
+    *format = image.format;
+    *width = image.width;
+    *height = image.height;
+
+    unmap_targa(&image);
 
     return data;
 }
+
+extern void* map_targa(const char *filepath, struct targa_image *image)
+{
+    memset(image, 0, sizeof(*image));
+
+    if(!vfs_open(filepath, &image->file))
+        return NULL;
+
+    if(!view_targa((const uint8_t*)image->file.data, image->file.size, image))
+    {
+        unmap_targa(image);
+        return NULL;
+    }
+
+    // Compressed images no longer need the file
+    if(image->buffer)
+        vfs_close(&image->file);
+
+    return image->pixels;
+}
+
+extern void* map_targa_memory(const void *data, size_t size, struct targa_image *image)
+{
+    memset(image, 0, sizeof(*image));
+
+    return view_targa((const uint8_t*)data, size, image);
+}
+
+extern void unmap_targa(struct targa_image *image)
+{
+    vfs_close(&image->file);
+    free(image->buffer);
+
+    memset(image, 0, sizeof(*image));
+}
+
+extern size_t info_targa(const char *filepath, struct targa_image *image)
+{
+    memset(image, 0, sizeof(*image));
+
+    struct vfs_view file;
+    struct tga_header header;
+    size_t size = 0;
+
+    if(!vfs_open(filepath, &file))
+        return 0;
+
+    if(parse_targa((const uint8_t*)file.data, file.size, &header))
+    {
+        targa_formats(header.bpp, &image->iformat, &image->format);
+
+        image->width = header.width;
+        image->height = header.height;
+
+        size = (size_t)header.width * header.height * (header.bpp / 8);
+    }
+
+    vfs_close(&file);
+
+    return size;
+}
+
+extern int decode_targa(const char *filepath, void *pixels, size_t size)
+{
+    struct vfs_view file;
+    struct tga_header header;
+    int decoded = 0;
+
+    if(!vfs_open(filepath, &file))
+        return 0;
+
+    if(parse_targa((const uint8_t*)file.data, file.size, &header) && ((size_t)header.width * header.height * (header.bpp / 8) <= size))
+        decoded = decode_targa_pixels((const uint8_t*)file.data, file.size, &header, (uint8_t*)pixels);
+
+    vfs_close(&file);
+
+    return decoded;
+}
+
+extern int stream_targa(const char *filepath, int band_rows, targa_band_func band, void *userdata)
+{
+    struct targa_image image;
+    struct tga_header header;
+
+    memset(&image, 0, sizeof(image));
+
+    if((band_rows <= 0) || !vfs_open(filepath, &image.file))
+        return 0;
+
+    const uint8_t *data = (const uint8_t*)image.file.data;
+
+    if(!parse_targa(data, image.file.size, &header))
+    {
+        unmap_targa(&image);
+        return 0;
+    }
+
+    targa_formats(header.bpp, &image.iformat, &image.format);
+
+    image.width = header.width;
+    image.height = header.height;
+
+    const size_t offset = targa_pixels_offset(&header);
+    const size_t row_size = (size_t)header.width * (header.bpp / 8);
+    struct targa_rle_stream stream;
+
+    // Uncompressed bands are views into the file, compressed ones reuse one band of memory
+    if(is_targa_rle(&header))
+    {
+        const int rows = band_rows < image.height ? band_rows : image.height;
+
+        init_targa_rle(&stream, data + offset, image.file.size - offset, header.bpp / 8);
+        image.buffer = malloc(row_size * (rows > 0 ? rows : 1));
+
+        if(!image.buffer)
+        {
+            unmap_targa(&image);
+            return 0;
+        }
+    }
+
+    int streamed = 1;
+
+    for(int y = 0; streamed && (y < image.height); y += band_rows)
+    {
+        const int rows = image.height - y < band_rows ? image.height - y : band_rows;
+        const void *pixels = data + offset + row_size * y;
+
+        if(image.buffer)
+        {
+            streamed = decode_targa_rle_stream(&stream, (uint8_t*)image.buffer, (size_t)header.width * rows);
+            pixels = image.buffer;
+        }
+
+        streamed = streamed && band(&image, y, rows, pixels, userdata);
+    }
+
+    unmap_targa(&image);
+
+    return streamed;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <glcore_450.h>
+#include "vfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct targa_image
+{
+    void       *pixels;         // first pixel, bottom row first
+    GLuint      iformat;
+    GLenum      format;
+    GLsizei     width;
+    GLsizei     height;
+
+    struct vfs_view file;       // the pixels of uncompressed images point into it
+    void       *buffer;         // decoded pixels of compressed images
+};
+
+void* load_targa(const char *filepath, GLuint *iformat, GLenum *format, GLsizei *width, GLsizei *height);
+
+// Uncompressed images are returned as a view into the file opened through the vfs,
+// compressed ones are decoded into memory. Release with unmap_targa in both cases.
+void* map_targa(const char *filepath, struct targa_image *image);
+// Same for a file already in memory, which has to outlive the image
+void* map_targa_memory(const void *data, size_t size, struct targa_image *image);
+void unmap_targa(struct targa_image *image);
+
+// Reads only the header, pixels stay NULL. Returns the size of the decoded pixels or 0.
+size_t info_targa(const char *filepath, struct targa_image *image);
+// Decodes the pixels into caller-provided memory of at least size bytes. Returns 0 on error.
+int decode_targa(const char *filepath, void *pixels, size_t size);
+
+// Receives rows [y, y + rows) in file order, bottom row first. The pixels are only valid
+// during the call, image has the format and size but no pixels. Returning 0 stops the stream.
+typedef int (*targa_band_func)(const struct targa_image *image, int y, int rows, const void *pixels, void *userdata);
+
+// Decodes band_rows rows at a time, so at most one band is ever held in memory.
+// Returns 0 on error or when the callback stopped the stream.
+int stream_targa(const char *filepath, int band_rows, targa_band_func band, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+
+#include "texture_array.h"
+#include "texture_loader.h"
+#include "pixel_convert.h"
+
+struct layer_upload
+{
+    GLuint      texture;
+    const int  *layers;         // file index to layer
+};
+
+static void upload_base_level(int index, struct targa_image *image, void *userdata)
+{
+    const struct layer_upload *upload = (const struct layer_upload*)userdata;
+
+    glTextureSubImage3D(upload->texture, 0, 0, 0, upload->layers[index], image->width, image->height, 1, image->format, GL_UNSIGNED_BYTE, image->pixels);
+}
+
+static int has_all_levels(const struct texture_layer *layer, GLsizei levels)
+{
+    for(GLsizei level = 0; level < levels; level++)
+        if(!layer->pixels[level])
+            return 0;
+
+    return 1;
+}
+
+extern GLuint create_texture_array(const struct texture_array_desc *desc)
+{
+    GLuint texture = 0;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+    glTextureStorage3D(texture, desc->levels, desc->iformat, desc->width, desc->height, desc->layers_count);
+
+    const char **filepaths = (const char**)malloc(desc->layers_count * sizeof(const char*));
+    int *layers = (int*)malloc(desc->layers_count * sizeof(int));
+    int files_count = 0;
+    int generate_mipmap = 0;
+
+    // Memory levels are converted one at a time, the base level is the largest
+    const int convert = desc->rgba8 && !desc->compressed && ((desc->format == GL_BGR) || (desc->format == GL_BGRA));
+    void *converted = convert ? malloc((size_t)desc->width * desc->height * 4) : NULL;
+
+    for(int i = 0; i < desc->layers_count; i++)
+    {
+        const struct texture_layer *layer = &desc->layers[i];
+
+        if(!layer->pixels[0])
+        {
+            filepaths[files_count] = layer->filepath;
+            layers[files_count++] = i;
+            generate_mipmap = 1;
+            continue;
+        }
+
+        GLsizei w = desc->width, h = desc->height;
+
+        // Precomputed levels are tightly packed down to 1x1
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        for(GLsizei level = 0; (level < desc->levels) && layer->pixels[level]; level++)
+        {
+            if(desc->compressed)
+                glCompressedTextureSubImage3D(texture, level, 0, 0, i, w, h, 1, desc->iformat, layer->sizes[level], layer->pixels[level]);
+            else if(converted)
+            {
+                convert_to_rgba8(layer->pixels[level], converted, (size_t)w * h, desc->format);
+                glTextureSubImage3D(texture, level, 0, 0, i, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, converted);
+            }
+            else
+                glTextureSubImage3D(texture, level, 0, 0, i, w, h, 1, desc->format, GL_UNSIGNED_BYTE, layer->pixels[level]);
+
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        if(!has_all_levels(layer, desc->levels))
+            generate_mipmap = 1;
+    }
+
+    free(converted);
+
+    struct layer_upload upload = {texture, layers};
+    const int flags = desc->rgba8 ? TEXTURE_LOADER_RGBA8 : 0;
+
+    if(desc->staging)
+        load_targa_staged(desc->staging, filepaths, files_count, flags, upload_base_level, &upload);
+    else
+        load_targa_parallel(filepaths, files_count, flags, upload_base_level, &upload);
+
+    // Block formats can't be mipmapped by the driver
+    if(generate_mipmap && !desc->compressed && (desc->levels > 1))
+        glGenerateTextureMipmap(texture);
+
+    free(layers);
+    free(filepaths);
+
+    return texture;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glcore_450.h>
+#include "staging_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEXTURE_ARRAY_MAX_LEVELS 16
+
+struct texture_layer
+{
+    const char     *filepath;                           // decoded when pixels[0] is NULL
+    const void     *pixels[TEXTURE_ARRAY_MAX_LEVELS];   // base level and optional precomputed mips
+    GLsizei         sizes[TEXTURE_ARRAY_MAX_LEVELS];    // byte sizes of compressed levels
+};
+
+struct texture_array_desc
+{
+    GLenum          iformat;
+    GLenum          format;                             // format of the pixels given in memory
+    GLsizei         width;
+    GLsizei         height;
+    GLsizei         levels;
+    int             compressed;                         // iformat is a block format, every layer brings all levels
+    int             rgba8;                              // BGR and BGRA pixels are converted to RGBA before upload
+
+    const struct texture_layer *layers;
+    int             layers_count;
+
+    struct staging_buffer *staging;                     // files are mapped instead when NULL
+};
+
+// Uploads the base level of every layer, then builds the mip chain with a single
+// glGenerateTextureMipmap. Generation is skipped when every layer brings all levels.
+GLuint create_texture_array(const struct texture_array_desc *desc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#include "texture_loader.h"
+#include "pixel_convert.h"
+
+#define MAX_LOADER_THREADS 16
+
+struct texture_loader
+{
+    const char        **filepaths;
+    int                 count;
+    int                 flags;
+    struct targa_image *images;
+
+    struct staging_buffer *staging;     // NULL when files are mapped instead
+    size_t             *offsets;
+    size_t             *sizes;
+
+    SDL_mutex          *lock;
+    SDL_cond           *jobs_cond;
+    int                 next;           // index of the next file to decode
+    int                 available;      // files with staging memory assigned
+
+    SDL_cond           *ready_cond;
+    int                *ready;          // indices of decoded images in completion order
+    int                 ready_count;
+};
+
+static int is_convertible(const struct texture_loader *loader, const struct targa_image *image)
+{
+    return (loader->flags & TEXTURE_LOADER_RGBA8) && ((image->format == GL_BGR) || (image->format == GL_BGRA));
+}
+
+static void convert_image(struct targa_image *image, const void *src, void *dst)
+{
+    convert_to_rgba8(src, dst, (size_t)image->width * image->height, image->format);
+
+    image->iformat = GL_RGBA8;
+    image->format = GL_RGBA;
+}
+
+// Views into the file are read-only, so those are converted into new memory
+static void convert_mapped(struct targa_image *image)
+{
+    const size_t size = (size_t)image->width * image->height * 4;
+    const int decoded = image->buffer != NULL;
+    void *pixels = decoded ? realloc(image->buffer, size) : malloc(size);
+
+    if(!pixels)
+    {
+        unmap_targa(image);
+        return;
+    }
+
+    convert_image(image, decoded ? pixels : image->pixels, pixels);
+    vfs_close(&image->file);
+
+    image->buffer = image->pixels = pixels;
+}
+
+static void decode_image(struct texture_loader *loader, int index)
+{
+    struct targa_image *image = &loader->images[index];
+
+    if(!loader->staging)
+    {
+        if(map_targa(loader->filepaths[index], image) && is_convertible(loader, image))
+            convert_mapped(image);
+
+        return;
+    }
+
+    // The offset is a valid pointer for glTextureSubImage* with the ring bound, even if 0
+    image->pixels = (void*)(uintptr_t)loader->offsets[index];
+
+    uint8_t *memory = loader->staging->memory + loader->offsets[index];
+
+    if((loader->offsets[index] == STAGING_NO_SPACE) || !decode_targa(loader->filepaths[index], memory, loader->sizes[index]))
+        loader->sizes[index] = 0;
+    else if(is_convertible(loader, image))
+        convert_image(image, memory, memory);
+}
+
+static int is_decoded(const struct texture_loader *loader, int index)
+{
+    return loader->staging ? loader->sizes[index] != 0 : loader->images[index].pixels != NULL;
+}
+
+static int loader_thread(void *data)
+{
+    struct texture_loader *loader = (struct texture_loader*)data;
+
+    SDL_LockMutex(loader->lock);
+
+    for(;;)
+    {
+        while((loader->next == loader->available) && (loader->next < loader->count))
+            SDL_CondWait(loader->jobs_cond, loader->lock);
+
+        if(loader->next == loader->count)
+            break;
+
+        const int index = loader->next++;
+        SDL_UnlockMutex(loader->lock);
+
+        decode_image(loader, index);
+
+        SDL_LockMutex(loader->lock);
+        loader->ready[loader->ready_count++] = index;
+        SDL_CondSignal(loader->ready_cond);
+    }
+
+    SDL_UnlockMutex(loader->lock);
+
+    return 0;
+}
+
+// Hands staging memory to as many files as fit. Blocks on the ring only when
+// nothing else is being decoded, otherwise uploads in flight would never retire.
+static void assign_staging(struct texture_loader *loader, int processed)
+{
+    int available = loader->available;
+
+    while(available < loader->count)
+    {
+        if(!loader->sizes[available])
+        {
+            loader->offsets[available++] = STAGING_NO_SPACE;
+            continue;
+        }
+
+        const size_t offset = staging_buffer_alloc(loader->staging, loader->sizes[available], available == processed);
+
+        if((offset == STAGING_NO_SPACE) && (available != processed))
+            break;
+
+        loader->offsets[available++] = offset;
+    }
+
+    SDL_LockMutex(loader->lock);
+    loader->available = available;
+    SDL_CondBroadcast(loader->jobs_cond);
+    SDL_UnlockMutex(loader->lock);
+}
+
+static void free_loader(struct texture_loader *loader)
+{
+    SDL_DestroyCond(loader->ready_cond);
+    SDL_DestroyCond(loader->jobs_cond);
+    SDL_DestroyMutex(loader->lock);
+    free(loader->sizes);
+    free(loader->offsets);
+    free(loader->ready);
+    free(loader->images);
+}
+
+static int load_textures(struct texture_loader *loader, texture_loaded_func loaded, void *userdata)
+{
+    const int count = loader->count;
+
+    loader->images = (struct targa_image*)calloc(count, sizeof(struct targa_image));
+    loader->ready = (int*)calloc(count, sizeof(int));
+    loader->lock = SDL_CreateMutex();
+    loader->jobs_cond = SDL_CreateCond();
+    loader->ready_cond = SDL_CreateCond();
+
+    if(loader->staging)
+    {
+        loader->offsets = (size_t*)calloc(count, sizeof(size_t));
+        loader->sizes = (size_t*)calloc(count, sizeof(size_t));
+    }
+
+    if(!loader->images || !loader->ready || !loader->lock || !loader->jobs_cond || !loader->ready_cond ||
+       (loader->staging && (!loader->offsets || !loader->sizes)))
+    {
+        free_loader(loader);
+        return 0;
+    }
+
+    if(loader->staging)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            loader->sizes[i] = info_targa(loader->filepaths[i], &loader->images[i]);
+
+            // room for the pixels expanded in place
+            if(loader->sizes[i] && is_convertible(loader, &loader->images[i]))
+                loader->sizes[i] = (size_t)loader->images[i].width * loader->images[i].height * 4;
+        }
+
+        assign_staging(loader, 0);
+    }
+    else
+        loader->available = count;
+
+    int threads_count = SDL_GetCPUCount();
+
+    if(threads_count > count)
+        threads_count = count;
+
+    if(threads_count > MAX_LOADER_THREADS)
+        threads_count = MAX_LOADER_THREADS;
+
+    if(threads_count < 1)
+        threads_count = 1;
+
+    SDL_Thread *threads[MAX_LOADER_THREADS] = {0};
+
+    for(int i = 0; i < threads_count; i++)
+        threads[i] = SDL_CreateThread(loader_thread, "texture loader", loader);
+
+    int loaded_count = 0;
+
+    if(loader->staging)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, loader->staging->buffer);
+
+    for(int processed = 0; processed < count; processed++)
+    {
+        SDL_LockMutex(loader->lock);
+        while(loader->ready_count == processed)
+        {
+            // Without any worker the files are decoded right here
+            if(!threads[0] && (loader->next < loader->available))
+            {
+                const int index = loader->next++;
+                SDL_UnlockMutex(loader->lock);
+                decode_image(loader, index);
+                SDL_LockMutex(loader->lock);
+                loader->ready[loader->ready_count++] = index;
+            }
+            else
+                SDL_CondWait(loader->ready_cond, loader->lock);
+        }
+
+        const int index = loader->ready[processed];
+        SDL_UnlockMutex(loader->lock);
+
+        struct targa_image *image = &loader->images[index];
+
+        if(is_decoded(loader, index))
+        {
+            loaded(index, image, userdata);
+            loaded_count++;
+        }
+        else
+            fprintf(stderr, "Can't load texture %s\n", loader->filepaths[index]);
+
+        if(loader->staging)
+        {
+            staging_buffer_fence(loader->staging);
+            assign_staging(loader, processed + 1);
+        }
+        else
+            unmap_targa(image);
+    }
+
+    if(loader->staging)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    for(int i = 0; i < threads_count; i++)
+        if(threads[i])
+            SDL_WaitThread(threads[i], NULL);
+
+    free_loader(loader);
+
+    return loaded_count;
+}
+
+extern int load_targa_parallel(const char **filepaths, int count, int flags, texture_loaded_func loaded, void *userdata)
+{
+    if(count <= 0)
+        return 0;
+
+    struct texture_loader loader = {0};
+
+    loader.filepaths = filepaths;
+    loader.count = count;
+    loader.flags = flags;
+
+    return load_textures(&loader, loaded, userdata);
+}
+
+extern int load_targa_staged(struct staging_buffer *staging, const char **filepaths, int count, int flags, texture_loaded_func loaded, void *userdata)
+{
+    if(count <= 0)
+        return 0;
+
+    // a ring that failed to map has nothing to decode into
+    if(!staging->memory)
+        return load_targa_parallel(filepaths, count, flags, loaded, userdata);
+
+    struct texture_loader loader = {0};
+
+    loader.filepaths = filepaths;
+    loader.count = count;
+    loader.flags = flags;
+    loader.staging = staging;
+
+    return load_textures(&loader, loaded, userdata);
+}
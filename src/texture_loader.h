@@ -0,0 +1,30 @@
+#pragma once
+
+#include "targa.h"
+#include "staging_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum TEXTURE_LOADER_FLAGS
+{
+    TEXTURE_LOADER_RGBA8 = 1        // BGR and BGRA images reach the callback converted to GL_RGBA8
+};
+
+typedef void (*texture_loaded_func)(int index, struct targa_image *image, void *userdata);
+
+// Decodes the files on a pool of worker threads. loaded is called on the calling
+// thread for every image as soon as it is ready, in completion order, so uploads
+// overlap with decoding of the remaining files. Returns the number of loaded images.
+int load_targa_parallel(const char **filepaths, int count, int flags, texture_loaded_func loaded, void *userdata);
+
+// Same, but the files are decoded straight into the staging ring. The ring is bound
+// as GL_PIXEL_UNPACK_BUFFER during the callbacks and image->pixels holds the offset
+// of the image in it, so the callback passes it to glTextureSubImage* unchanged.
+// Without mapped memory in the ring it falls back to load_targa_parallel.
+int load_targa_staged(struct staging_buffer *staging, const char **filepaths, int count, int flags, texture_loaded_func loaded, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "texture_pool.h"
+#include "mipmap.h"
+
+static GLsizei size_class(GLsizei size)
+{
+    GLsizei rounded = 1;
+
+    while(rounded < size)
+        rounded *= 2;
+
+    return rounded;
+}
+
+static struct texture_pool_class* find_class(struct texture_pool *pool, GLenum iformat, GLsizei width, GLsizei height)
+{
+    for(int i = 0; i < pool->classes_count; i++)
+    {
+        struct texture_pool_class *c = &pool->classes[i];
+
+        if((c->iformat == iformat) && (c->width == width) && (c->height == height))
+            return c;
+    }
+
+    if(pool->classes_count == TEXTURE_POOL_MAX_CLASSES)
+        return NULL;
+
+    struct texture_pool_class *c = &pool->classes[pool->classes_count++];
+
+    c->iformat = iformat;
+    c->width = width;
+    c->height = height;
+    c->levels = mip_levels_count(width, height);
+
+    return c;
+}
+
+static int grow_class(const struct texture_pool *pool, struct texture_pool_class *c)
+{
+    const GLsizei layers = pool->layers_per_array;
+    GLuint *arrays = (GLuint*)realloc(c->arrays, (c->arrays_count + 1) * sizeof(GLuint));
+
+    if(!arrays)
+        return 0;
+
+    c->arrays = arrays;
+
+    int *free_slots = (int*)realloc(c->free_slots, (size_t)(c->arrays_count + 1) * layers * sizeof(int));
+
+    if(!free_slots)
+        return 0;
+
+    c->free_slots = free_slots;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &c->arrays[c->arrays_count]);
+    glTextureStorage3D(c->arrays[c->arrays_count], c->levels, c->iformat, c->width, c->height, layers);
+
+    // pushed in reverse, so layers are handed out in order
+    for(GLsizei layer = layers; layer-- > 0;)
+        c->free_slots[c->free_count++] = c->arrays_count * layers + layer;
+
+    c->arrays_count++;
+
+    return 1;
+}
+
+static GLsizei level_size(GLsizei size, GLsizei level)
+{
+    return size >> level ? size >> level : 1;
+}
+
+// Replicates column x - 1 up to the width of the level, each copy doubles the filled span
+static void pad_columns(GLuint texture, GLint layer, GLsizei level, GLsizei x, GLsizei width, GLsizei height)
+{
+    if(x >= width)
+        return;
+
+    glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, level, x - 1, 0, layer,
+                       texture, GL_TEXTURE_2D_ARRAY, level, x, 0, layer, 1, height, 1);
+
+    for(GLsizei filled = 1; x + filled < width; filled *= 2)
+    {
+        const GLsizei count = filled < width - x - filled ? filled : width - x - filled;
+
+        glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, level, x, 0, layer,
+                           texture, GL_TEXTURE_2D_ARRAY, level, x + filled, 0, layer, count, height, 1);
+    }
+}
+
+// Same for row y - 1 up to the height of the level
+static void pad_rows(GLuint texture, GLint layer, GLsizei level, GLsizei y, GLsizei width, GLsizei height)
+{
+    if(y >= height)
+        return;
+
+    glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, level, 0, y - 1, layer,
+                       texture, GL_TEXTURE_2D_ARRAY, level, 0, y, layer, width, 1, 1);
+
+    for(GLsizei filled = 1; y + filled < height; filled *= 2)
+    {
+        const GLsizei count = filled < height - y - filled ? filled : height - y - filled;
+
+        glCopyImageSubData(texture, GL_TEXTURE_2D_ARRAY, level, 0, y, layer,
+                           texture, GL_TEXTURE_2D_ARRAY, level, 0, y + filled, layer, width, count, 1);
+    }
+}
+
+extern void texture_pool_init(struct texture_pool *pool, GLsizei layers_per_array)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    GLint max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+    pool->layers_per_array = (max_layers > 0) && (layers_per_array > max_layers) ? max_layers : layers_per_array;
+
+    if(pool->layers_per_array < 1)
+        pool->layers_per_array = 1;
+}
+
+extern void texture_pool_free(struct texture_pool *pool)
+{
+    for(int i = 0; i < pool->classes_count; i++)
+    {
+        struct texture_pool_class *c = &pool->classes[i];
+
+        glDeleteTextures(c->arrays_count, c->arrays);
+
+        free(c->arrays);
+        free(c->free_slots);
+    }
+
+    memset(pool, 0, sizeof(*pool));
+}
+
+extern int texture_pool_alloc(struct texture_pool *pool, GLenum iformat, GLsizei width, GLsizei height, struct texture_handle *handle)
+{
+    memset(handle, 0, sizeof(*handle));
+
+    if((width <= 0) || (height <= 0))
+        return 0;
+
+    struct texture_pool_class *c = find_class(pool, iformat, size_class(width), size_class(height));
+
+    if(!c || (!c->free_count && !grow_class(pool, c)))
+        return 0;
+
+    const int slot = c->free_slots[--c->free_count];
+
+    handle->texture = c->arrays[slot / pool->layers_per_array];
+    handle->layer = slot % pool->layers_per_array;
+    handle->width = width;
+    handle->height = height;
+    handle->scale[0] = (float)width / (float)c->width;
+    handle->scale[1] = (float)height / (float)c->height;
+    handle->size_class = (int)(c - pool->classes);
+    handle->slot = slot;
+
+    return 1;
+}
+
+extern void texture_pool_release(struct texture_pool *pool, struct texture_handle *handle)
+{
+    if(!handle->texture)
+        return;
+
+    struct texture_pool_class *c = &pool->classes[handle->size_class];
+
+    c->free_slots[c->free_count++] = handle->slot;
+
+    memset(handle, 0, sizeof(*handle));
+}
+
+extern void texture_pool_pad(const struct texture_pool *pool, const struct texture_handle *handle, GLsizei levels)
+{
+    if(!handle->texture || (levels < 1))
+        return;
+
+    const struct texture_pool_class *c = &pool->classes[handle->size_class];
+
+    if(levels > c->levels)
+        levels = c->levels;
+
+    for(GLsizei level = 0; level < c->levels; level++)
+    {
+        const GLsizei width = level_size(c->width, level);
+        const GLsizei height = level_size(c->height, level);
+        GLsizei image_width = level_size(handle->width, level);
+        GLsizei image_height = level_size(handle->height, level);
+
+        if(level >= levels)
+        {
+            glCopyImageSubData(handle->texture, GL_TEXTURE_2D_ARRAY, levels - 1, 0, 0, handle->layer,
+                               handle->texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, handle->layer, 1, 1, 1);
+
+            image_width = image_height = 1;
+        }
+
+        pad_columns(handle->texture, handle->layer, level, image_width, width, image_height);
+        pad_rows(handle->texture, handle->layer, level, image_height, width, height);
+    }
+}
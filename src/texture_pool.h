@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glcore_450.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEXTURE_POOL_MAX_CLASSES 32
+
+// A layer of one of the pool's arrays
+struct texture_handle
+{
+    GLuint      texture;            // 2D array, 0 when the allocation failed
+    GLint       layer;
+    GLsizei     width;              // of the image, the layer may be larger
+    GLsizei     height;
+    float       scale[2];           // texture coordinates scale to the image inside the layer
+
+    int         size_class;
+    int         slot;
+};
+
+// Arrays of one format and power of two size, with a full mip chain each
+struct texture_pool_class
+{
+    GLenum      iformat;
+    GLsizei     width;
+    GLsizei     height;
+    GLsizei     levels;
+
+    GLuint     *arrays;
+    int         arrays_count;
+    int        *free_slots;         // stack of array index * layers_per_array + layer
+    int         free_count;
+};
+
+struct texture_pool
+{
+    GLsizei     layers_per_array;
+    struct texture_pool_class classes[TEXTURE_POOL_MAX_CLASSES];
+    int         classes_count;
+};
+
+void texture_pool_init(struct texture_pool *pool, GLsizei layers_per_array);
+// Deletes every array, handles still out become invalid
+void texture_pool_free(struct texture_pool *pool);
+
+// Hands out a free layer of the size class width x height rounds up to, a new array
+// is only created when the class has none left. Returns 0 on failure.
+int texture_pool_alloc(struct texture_pool *pool, GLenum iformat, GLsizei width, GLsizei height, struct texture_handle *handle);
+void texture_pool_release(struct texture_pool *pool, struct texture_handle *handle);
+
+// Once the first levels levels of the image are uploaded to the layer, replicates their
+// last column and row out to the edge of the layer, so filtering at the image border
+// never reads texels outside it. The levels of the class past them get the corner texel
+// of the last one.
+void texture_pool_pad(const struct texture_pool *pool, const struct texture_handle *handle, GLsizei levels);
+
+#ifdef __cplusplus
+}
+#endif
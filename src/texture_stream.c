@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "texture_stream.h"
+#include "pixel_convert.h"
+#include "mipmap.h"
+
+#define MAX_STREAM_THREADS 16
+
+struct texture_stream
+{
+    GLuint              texture;
+    int                 rgba8;
+    int                 srgb;
+    GLsizei             width;
+    GLsizei             height;
+    GLsizei             levels;
+
+    const char        **filepaths;
+    int                 count;
+    struct mip_chain   *chains;
+    SDL_atomic_t       *ready;          // 1 once the chain is loaded, -1 if it can't be
+    SDL_atomic_t        next;           // next file for the workers
+
+    SDL_Thread         *threads[MAX_STREAM_THREADS];
+    int                 threads_count;
+
+    GLsizei             resident;       // finest level uploaded to every layer, levels if none is
+    int                 layer;          // next layer to upload at resident - 1
+    void               *converted;
+};
+
+static int stream_thread(void *data)
+{
+    struct texture_stream *stream = (struct texture_stream*)data;
+    int index;
+
+    while((index = SDL_AtomicAdd(&stream->next, 1)) < stream->count)
+    {
+        struct mip_chain *chain = &stream->chains[index];
+        const int loaded = load_mip_chain(stream->filepaths[index], stream->levels, stream->srgb, chain) &&
+                (chain->width == stream->width) && (chain->height == stream->height) && (chain->levels == stream->levels);
+
+        SDL_AtomicSet(&stream->ready[index], loaded ? 1 : -1);
+    }
+
+    return 0;
+}
+
+static void level_size(const struct texture_stream *stream, GLsizei level, GLsizei *w, GLsizei *h)
+{
+    *w = stream->width >> level ? stream->width >> level : 1;
+    *h = stream->height >> level ? stream->height >> level : 1;
+}
+
+static void clear_layer_level(struct texture_stream *stream, GLsizei level, int layer)
+{
+    static const uint8_t grey[4] = {128, 128, 128, 255};
+    GLsizei w, h;
+
+    level_size(stream, level, &w, &h);
+    glClearTexSubImage(stream->texture, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
+
+static void upload_layer_level(struct texture_stream *stream, GLsizei level, int layer)
+{
+    GLsizei w, h;
+
+    level_size(stream, level, &w, &h);
+
+    const struct mip_chain *chain = &stream->chains[layer];
+    const void *pixels = chain->pixels[level];
+    GLenum format = chain->format;
+
+    if(stream->converted && convert_to_rgba8(pixels, stream->converted, (size_t)w * h, format))
+    {
+        pixels = stream->converted;
+        format = GL_RGBA;
+    }
+
+    glTextureSubImage3D(stream->texture, level, 0, 0, layer, w, h, 1, format, GL_UNSIGNED_BYTE, pixels);
+}
+
+extern struct texture_stream* create_texture_stream(const struct texture_array_desc *desc, int srgb, GLuint *texture)
+{
+    struct texture_stream *stream = (struct texture_stream*)calloc(1, sizeof(struct texture_stream));
+
+    if(!stream)
+        return NULL;
+
+    stream->rgba8 = desc->rgba8;
+    stream->srgb = srgb;
+    stream->width = desc->width;
+    stream->height = desc->height;
+    stream->levels = desc->levels;
+    stream->count = desc->layers_count;
+    stream->resident = desc->levels;
+
+    stream->filepaths = (const char**)malloc(stream->count * sizeof(const char*));
+    stream->chains = (struct mip_chain*)calloc(stream->count, sizeof(struct mip_chain));
+    stream->ready = (SDL_atomic_t*)calloc(stream->count, sizeof(SDL_atomic_t));
+
+    if(stream->rgba8)
+        stream->converted = malloc((size_t)desc->width * desc->height * 4);
+
+    for(int i = 0; i < stream->count; i++)
+        stream->filepaths[i] = desc->layers[i].filepath;
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &stream->texture);
+    glTextureStorage3D(stream->texture, desc->levels, desc->iformat, desc->width, desc->height, desc->layers_count);
+
+    // The placeholder is the only level the sampler can reach until real levels arrive
+    for(int i = 0; i < stream->count; i++)
+        clear_layer_level(stream, stream->levels - 1, i);
+
+    glTextureParameteri(stream->texture, GL_TEXTURE_BASE_LEVEL, stream->levels - 1);
+
+    stream->threads_count = SDL_GetCPUCount();
+
+    if(stream->threads_count > stream->count)
+        stream->threads_count = stream->count;
+
+    if(stream->threads_count > MAX_STREAM_THREADS)
+        stream->threads_count = MAX_STREAM_THREADS;
+
+    for(int i = 0; i < stream->threads_count; i++)
+        stream->threads[i] = SDL_CreateThread(stream_thread, "texture stream", stream);
+
+    // Without any worker the files are loaded right here
+    if((stream->threads_count < 1) || !stream->threads[0])
+        stream_thread(stream);
+
+    *texture = stream->texture;
+
+    return stream;
+}
+
+extern int update_texture_stream(struct texture_stream *stream, size_t budget)
+{
+    size_t uploaded = 0;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    while(stream->resident > 0)
+    {
+        const GLsizei level = stream->resident - 1;
+
+        // Layers go in order, so a layer still loading holds back the finer levels
+        for(; stream->layer < stream->count; stream->layer++)
+        {
+            const int ready = SDL_AtomicGet(&stream->ready[stream->layer]);
+
+            if(!ready)
+                break;
+
+            if(ready < 0)
+            {
+                clear_layer_level(stream, level, stream->layer);
+                continue;
+            }
+
+            GLsizei w, h;
+            level_size(stream, level, &w, &h);
+
+            const size_t size = (size_t)w * h * stream->chains[stream->layer].channels;
+
+            if(uploaded && (uploaded + size > budget))
+                break;
+
+            upload_layer_level(stream, level, stream->layer);
+            uploaded += size;
+        }
+
+        if(stream->layer < stream->count)
+            break;
+
+        stream->layer = 0;
+        stream->resident = level;
+
+        glTextureParameteri(stream->texture, GL_TEXTURE_BASE_LEVEL, level);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return stream->resident == 0;
+}
+
+extern void free_texture_stream(struct texture_stream *stream)
+{
+    if(!stream)
+        return;
+
+    // no new files are started
+    SDL_AtomicSet(&stream->next, stream->count);
+
+    for(int i = 0; i < stream->threads_count; i++)
+        if(stream->threads[i])
+            SDL_WaitThread(stream->threads[i], NULL);
+
+    for(int i = 0; i < stream->count; i++)
+        free_mip_chain(&stream->chains[i]);
+
+    free(stream->converted);
+    free(stream->ready);
+    free(stream->chains);
+    free(stream->filepaths);
+    free(stream);
+}
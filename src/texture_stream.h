@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <glcore_450.h>
+#include "texture_array.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct texture_stream;
+
+// Creates the storage of a texture array and returns right away. Until real pixels
+// arrive every layer shows a grey placeholder at the smallest level, with
+// GL_TEXTURE_BASE_LEVEL clamped to it. Mip chains of the layer files are loaded on
+// worker threads, the file paths have to outlive the stream.
+struct texture_stream* create_texture_stream(const struct texture_array_desc *desc, int srgb, GLuint *texture);
+
+// Uploads the next levels, smallest first, up to budget bytes but at least one layer
+// level per call. The base level clamp relaxes once a level is resident in every
+// layer. Returns 1 when the full chain is resident and the stream can be freed.
+int update_texture_stream(struct texture_stream *stream, size_t budget);
+
+// Waits for the workers still running, the texture stays with the caller
+void free_texture_stream(struct texture_stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
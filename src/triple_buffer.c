@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "triple_buffer.h"
+
+#define TRIPLE_BUFFER_FRESH 4
+#define CACHE_LINE 64
+
+extern int triple_buffer_init(struct triple_buffer *buffer, size_t size)
+{
+    memset(buffer, 0, sizeof(*buffer));
+
+    buffer->stride = (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+
+    if(!buffer->stride)
+        buffer->stride = CACHE_LINE;
+
+    buffer->memory = (unsigned char*)calloc(3, buffer->stride);
+
+    if(!buffer->memory)
+        return 0;
+
+    buffer->front = 0;
+    SDL_AtomicSet(&buffer->middle, 1);
+    buffer->back = 2;
+
+    return 1;
+}
+
+extern void triple_buffer_free(struct triple_buffer *buffer)
+{
+    free(buffer->memory);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+extern void* triple_buffer_back(struct triple_buffer *buffer)
+{
+    return buffer->memory + buffer->back * buffer->stride;
+}
+
+extern void triple_buffer_publish(struct triple_buffer *buffer)
+{
+    // full barrier, the writes to the slot are visible before its index is
+    buffer->back = SDL_AtomicSet(&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH) & ~TRIPLE_BUFFER_FRESH;
+}
+
+extern const void* triple_buffer_front(struct triple_buffer *buffer)
+{
+    if(SDL_AtomicGet(&buffer->middle) & TRIPLE_BUFFER_FRESH)
+        buffer->front = SDL_AtomicSet(&buffer->middle, buffer->front) & ~TRIPLE_BUFFER_FRESH;
+
+    return buffer->memory + buffer->front * buffer->stride;
+}
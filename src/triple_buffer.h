@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <SDL2/SDL_atomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hands the latest of a stream of fixed size values from one writer thread to one
+// reader thread. Neither side ever waits: the writer fills its back slot and swaps
+// it with the middle one, the reader swaps its front slot with the middle one when
+// something new was published there. Values published in between are skipped.
+struct triple_buffer
+{
+    unsigned char *memory;
+    size_t      stride;         // slots on separate cache lines
+
+    SDL_atomic_t middle;        // slot index, TRIPLE_BUFFER_FRESH once published
+    int         back;           // writer's
+    int         front;          // reader's
+};
+
+int triple_buffer_init(struct triple_buffer *buffer, size_t size);
+void triple_buffer_free(struct triple_buffer *buffer);
+
+// Writer side, the slot stays valid until the next publish
+void* triple_buffer_back(struct triple_buffer *buffer);
+void triple_buffer_publish(struct triple_buffer *buffer);
+
+// Reader side, returns the latest value published or the previous one again.
+// Zeroed until the first publish.
+const void* triple_buffer_front(struct triple_buffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
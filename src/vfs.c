@@ -0,0 +1,410 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "vfs.h"
+#include "io_batch.h"
+
+struct vfs_archive
+{
+    struct vfs_view file;
+    char       *root;
+    size_t      root_length;
+
+    const struct vfs_archive_entry *entries;
+    uint32_t    entries_count;
+    const char *names;
+};
+
+static struct vfs_archive archive;
+
+static const void* open_disk(const char *path, struct vfs_view *view)
+{
+#ifdef _WIN32
+    FILE *fp = fopen(path, "rb");
+
+    if(!fp)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    const long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    view->buffer = length > 0 ? malloc((size_t)length) : NULL;
+
+    if(!view->buffer || (fread(view->buffer, 1, (size_t)length, fp) != (size_t)length))
+    {
+        fclose(fp);
+        vfs_close(view);
+        return NULL;
+    }
+
+    fclose(fp);
+
+    view->data = view->buffer;
+    view->size = (size_t)length;
+
+    return view->data;
+#else
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+
+    if((fstat(fd, &st) < 0) || (st.st_size <= 0))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE; // the whole file is about to be read anyway
+#endif
+
+    void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+
+    if(mapping == MAP_FAILED)
+        return NULL;
+
+    madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    view->data = view->mapping = mapping;
+    view->size = view->mapping_size = (size_t)st.st_size;
+
+    return view->data;
+#endif
+}
+
+extern int vfs_mount(const char *archive_path, const char *root)
+{
+    vfs_unmount();
+
+    if(!open_disk(archive_path, &archive.file))
+        return 0;
+
+    const uint8_t *data = (const uint8_t*)archive.file.data;
+    const size_t size = archive.file.size;
+    struct vfs_archive_header header;
+
+    if(size < sizeof(header))
+    {
+        vfs_unmount();
+        return 0;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if((header.magic != VFS_ARCHIVE_MAGIC) || (header.version != VFS_ARCHIVE_VERSION) ||
+       (header.entries_offset > size) || ((size - header.entries_offset) / sizeof(struct vfs_archive_entry) < header.entries_count) ||
+       (header.names_offset > size))
+    {
+        vfs_unmount();
+        return 0;
+    }
+
+    archive.entries = (const struct vfs_archive_entry*)(data + header.entries_offset);
+    archive.entries_count = header.entries_count;
+    archive.names = (const char*)data + header.names_offset;
+
+    // find_entry compares names without checking them again
+    const size_t names_size = size - header.names_offset;
+
+    for(uint32_t i = 0; i < archive.entries_count; i++)
+    {
+        const struct vfs_archive_entry *entry = &archive.entries[i];
+
+        if((entry->name_offset > names_size) || (entry->name_length > names_size - entry->name_offset))
+        {
+            vfs_unmount();
+            return 0;
+        }
+    }
+
+    archive.root_length = strlen(root);
+    archive.root = (char*)malloc(archive.root_length + 1);
+
+    if(!archive.root)
+    {
+        vfs_unmount();
+        return 0;
+    }
+
+    memcpy(archive.root, root, archive.root_length + 1);
+
+    return 1;
+}
+
+extern void vfs_unmount(void)
+{
+    vfs_close(&archive.file);
+    free(archive.root);
+    memset(&archive, 0, sizeof(archive));
+}
+
+static const struct vfs_archive_entry* find_entry(const char *name)
+{
+    const size_t length = strlen(name);
+    uint32_t first = 0, last = archive.entries_count;
+
+    while(first < last)
+    {
+        const uint32_t middle = first + (last - first) / 2;
+        const struct vfs_archive_entry *entry = &archive.entries[middle];
+        const size_t common = entry->name_length < length ? entry->name_length : length;
+        int order = memcmp(archive.names + entry->name_offset, name, common);
+
+        if(!order)
+            order = entry->name_length < length ? -1 : (entry->name_length > length ? 1 : 0);
+
+        if(!order)
+            return entry;
+
+        if(order < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return NULL;
+}
+
+static const void* open_archived(const struct vfs_archive_entry *entry, struct vfs_view *view)
+{
+    if((entry->offset > archive.file.size) || (entry->size > archive.file.size - entry->offset))
+        return NULL;
+
+    const uint8_t *data = (const uint8_t*)archive.file.data + entry->offset;
+
+    if(entry->compression == VFS_COMPRESSION_NONE)
+    {
+        view->data = data;
+        view->size = entry->size;
+
+        return view->data;
+    }
+
+    if(entry->compression != VFS_COMPRESSION_LZ4)
+        return NULL;
+
+    view->buffer = malloc(entry->original_size);
+
+    if(!view->buffer || (lz4_decompress(data, entry->size, (uint8_t*)view->buffer, entry->original_size) != entry->original_size))
+    {
+        vfs_close(view);
+        return NULL;
+    }
+
+    view->data = view->buffer;
+    view->size = entry->original_size;
+
+    return view->data;
+}
+
+static const struct vfs_archive_entry* find_archived(const char *path)
+{
+    if(archive.entries && !strncmp(path, archive.root, archive.root_length))
+        return find_entry(path + archive.root_length);
+
+    return NULL;
+}
+
+extern const void* vfs_open(const char *path, struct vfs_view *view)
+{
+    memset(view, 0, sizeof(*view));
+
+    const struct vfs_archive_entry *entry = find_archived(path);
+
+    if(entry)
+        return open_archived(entry, view);
+
+    return open_disk(path, view);
+}
+
+extern int vfs_open_batch(const char **paths, int count, struct vfs_view *views, int flags)
+{
+    int opened = 0;
+
+#ifdef _WIN32
+    (void)flags;
+
+    for(int i = 0; i < count; i++)
+        if(vfs_open(paths[i], &views[i]))
+            opened++;
+#else
+    struct io_read *reads = (struct io_read*)calloc(count, sizeof(struct io_read));
+    int *indices = (int*)malloc(count * sizeof(int));
+    int reads_count = 0;
+
+    if(!reads || !indices)
+    {
+        free(reads);
+        free(indices);
+        return 0;
+    }
+
+    // Archived files are served as usual, disk files get a buffer of their size
+    for(int i = 0; i < count; i++)
+    {
+        memset(&views[i], 0, sizeof(views[i]));
+
+        const struct vfs_archive_entry *entry = find_archived(paths[i]);
+
+        if(entry)
+        {
+            if(open_archived(entry, &views[i]))
+                opened++;
+
+            continue;
+        }
+
+        const int fd = open(paths[i], O_RDONLY);
+        struct stat st;
+
+        if(fd < 0)
+            continue;
+
+        void *buffer = (fstat(fd, &st) == 0) && (st.st_size > 0) ? malloc((size_t)st.st_size) : NULL;
+
+        if(!buffer)
+        {
+            close(fd);
+            continue;
+        }
+
+        reads[reads_count].fd = fd;
+        reads[reads_count].buffer = buffer;
+        reads[reads_count].size = (size_t)st.st_size;
+        indices[reads_count++] = i;
+    }
+
+    io_read_batch(reads, reads_count, flags);
+
+    for(int k = 0; k < reads_count; k++)
+    {
+        struct vfs_view *view = &views[indices[k]];
+
+        close(reads[k].fd);
+
+        if(reads[k].error)
+        {
+            free(reads[k].buffer);
+            continue;
+        }
+
+        view->data = view->buffer = reads[k].buffer;
+        view->size = reads[k].size;
+        opened++;
+    }
+
+    free(indices);
+    free(reads);
+#endif
+
+    return opened;
+}
+
+extern void vfs_close(struct vfs_view *view)
+{
+#ifndef _WIN32
+    if(view->mapping)
+        munmap(view->mapping, view->mapping_size);
+#endif
+
+    free(view->buffer);
+    memset(view, 0, sizeof(*view));
+}
+
+// LZ4 block format: a token with literal and match lengths, extra length bytes,
+// literals, a 16 bit match offset, extra match length bytes.
+extern size_t lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *src_end = src + src_size;
+    uint8_t *out = dst;
+    uint8_t *out_end = dst + dst_size;
+
+    while(src < src_end)
+    {
+        const uint8_t token = *src++;
+        size_t length = token >> 4;
+
+        if(length == 15)
+        {
+            uint8_t extra;
+
+            do
+            {
+                if(src == src_end)
+                    return 0;
+
+                extra = *src++;
+                length += extra;
+            }
+            while(extra == 255);
+        }
+
+        if(((size_t)(src_end - src) < length) || ((size_t)(out_end - out) < length))
+            return 0;
+
+        memcpy(out, src, length);
+        src += length;
+        out += length;
+
+        // the last sequence has no match
+        if(src == src_end)
+            break;
+
+        if(src_end - src < 2)
+            return 0;
+
+        const size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+
+        if(!offset || (offset > (size_t)(out - dst)))
+            return 0;
+
+        length = (token & 15) + 4;
+
+        if((token & 15) == 15)
+        {
+            uint8_t extra;
+
+            do
+            {
+                if(src == src_end)
+                    return 0;
+
+                extra = *src++;
+                length += extra;
+            }
+            while(extra == 255);
+        }
+
+        if((size_t)(out_end - out) < length)
+            return 0;
+
+        // matches may overlap their own output
+        const uint8_t *match = out - offset;
+
+        for(size_t i = 0; i < length; i++)
+            out[i] = match[i];
+
+        out += length;
+    }
+
+    return (size_t)(out - dst);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VFS_ARCHIVE_MAGIC 0x4b415041 // "APAK"
+#define VFS_ARCHIVE_VERSION 1
+
+enum VFS_COMPRESSION
+{
+    VFS_COMPRESSION_NONE = 0,
+    VFS_COMPRESSION_LZ4 = 1         // a single LZ4 block per file
+};
+
+struct vfs_archive_header
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    entries_count;
+    uint32_t    reserved;
+    uint64_t    entries_offset;
+    uint64_t    names_offset;
+};
+
+// Entries are sorted by name
+struct vfs_archive_entry
+{
+    uint64_t    offset;
+    uint64_t    size;               // stored size
+    uint64_t    original_size;
+    uint32_t    name_offset;
+    uint32_t    name_length;
+    uint32_t    compression;
+    uint32_t    reserved;
+};
+
+// Read-only view of a whole file
+struct vfs_view
+{
+    const void *data;
+    size_t      size;
+
+    void       *mapping;            // disk file mapped for this view
+    size_t      mapping_size;
+    void       *buffer;             // decompressed or read into memory for this view
+};
+
+// Serves paths starting with root from the archive, everything else from disk
+int vfs_mount(const char *archive_path, const char *root);
+void vfs_unmount(void);
+
+const void* vfs_open(const char *path, struct vfs_view *view);
+void vfs_close(struct vfs_view *view);
+
+// Opens several files at once, the reads of files on disk are submitted together
+// (see io_read_batch, flags are IO_BATCH_FLAGS) into a buffer per file. Views of
+// files that can't be opened stay empty. Returns the number of opened files.
+int vfs_open_batch(const char **paths, int count, struct vfs_view *views, int flags);
+
+size_t lz4_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+
+#ifdef __cplusplus
+}
+#endif
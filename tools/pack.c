@@ -0,0 +1,299 @@
+/*
+ * Packs files into an archive read by vfs_mount, optionally LZ4 compressed
+ * usage: pack [-lz4] output.pak root files...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5         // the block always ends with literals
+#define LZ4_MATCH_LIMIT 12          // no match starts in the last bytes
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 16
+
+#define PACK_ALIGNMENT 16
+
+struct pack_file
+{
+    const char *name;               // relative to root
+    uint8_t    *data;               // as stored
+    size_t      size;
+    size_t      original_size;
+    uint32_t    compression;
+};
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static uint8_t* write_length(uint8_t *out, size_t length)
+{
+    for(; length >= 255; length -= 255)
+        *out++ = 255;
+
+    *out++ = (uint8_t)length;
+
+    return out;
+}
+
+// A match length of 0 writes the last sequence
+static uint8_t* write_sequence(uint8_t *out, const uint8_t *literals, size_t literals_length, size_t offset, size_t match_length)
+{
+    uint8_t *token = out++;
+
+    *token = (uint8_t)((literals_length < 15 ? literals_length : 15) << 4);
+
+    if(literals_length >= 15)
+        out = write_length(out, literals_length - 15);
+
+    memcpy(out, literals, literals_length);
+    out += literals_length;
+
+    if(match_length)
+    {
+        const size_t extra = match_length - LZ4_MIN_MATCH;
+
+        *out++ = (uint8_t)(offset & 0xff);
+        *out++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(extra < 15 ? extra : 15);
+
+        if(extra >= 15)
+            out = write_length(out, extra - 15);
+    }
+
+    return out;
+}
+
+static size_t lz4_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Greedy single-probe LZ4 block compressor, dst needs lz4_bound(size) bytes
+static size_t lz4_compress(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    uint32_t *table = (uint32_t*)calloc((size_t)1 << LZ4_HASH_BITS, sizeof(uint32_t));
+
+    if(!table)
+        return 0;
+
+    const uint8_t *end = src + size;
+    const uint8_t *anchor = src;
+    const uint8_t *ip = src;
+    uint8_t *out = dst;
+
+    while((size_t)(end - ip) >= LZ4_MATCH_LIMIT)
+    {
+        const uint32_t v = read32(ip);
+        const uint32_t h = (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        const uint8_t *ref = src + table[h];
+
+        table[h] = (uint32_t)(ip - src);
+
+        if((ref < ip) && (ip - ref <= LZ4_MAX_OFFSET) && (read32(ref) == v))
+        {
+            const uint8_t *p = ip + LZ4_MIN_MATCH;
+            const uint8_t *q = ref + LZ4_MIN_MATCH;
+
+            while((p < end - LZ4_LAST_LITERALS) && (*p == *q))
+                p++, q++;
+
+            out = write_sequence(out, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(p - ip));
+            ip = anchor = p;
+        }
+        else
+            ip++;
+    }
+
+    out = write_sequence(out, anchor, (size_t)(end - anchor), 0, 0);
+
+    free(table);
+
+    return (size_t)(out - dst);
+}
+
+static int read_file(const char *path, struct pack_file *file)
+{
+    FILE *fp = fopen(path, "rb");
+
+    if(!fp)
+        return 0;
+
+    fseek(fp, 0, SEEK_END);
+    const long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    file->size = file->original_size = length > 0 ? (size_t)length : 0;
+    file->data = (uint8_t*)malloc(file->size + 1);
+
+    const int read = file->data && (fread(file->data, 1, file->size, fp) == file->size);
+
+    fclose(fp);
+
+    return read;
+}
+
+static void compress_file(struct pack_file *file)
+{
+    uint8_t *compressed = (uint8_t*)malloc(lz4_bound(file->size));
+
+    if(!compressed)
+        return;
+
+    const size_t size = lz4_compress(file->data, file->size, compressed);
+
+    // Only kept when it saves space, already compressed data stays as it is
+    if(size && (size < file->size))
+    {
+        free(file->data);
+
+        file->data = compressed;
+        file->size = size;
+        file->compression = VFS_COMPRESSION_LZ4;
+    }
+    else
+        free(compressed);
+}
+
+static int compare_files(const void *a, const void *b)
+{
+    return strcmp(((const struct pack_file*)a)->name, ((const struct pack_file*)b)->name);
+}
+
+static void write_padding(FILE *fp, uint64_t *offset)
+{
+    static const uint8_t zeros[PACK_ALIGNMENT] = {0};
+    const size_t padding = (PACK_ALIGNMENT - *offset % PACK_ALIGNMENT) % PACK_ALIGNMENT;
+
+    fwrite(zeros, 1, padding, fp);
+    *offset += padding;
+}
+
+static int write_archive(const char *output, struct pack_file *files, uint32_t count)
+{
+    FILE *fp = fopen(output, "wb");
+
+    if(!fp)
+        return 0;
+
+    struct vfs_archive_header header = {0};
+    struct vfs_archive_entry *entries = (struct vfs_archive_entry*)calloc(count ? count : 1, sizeof(*entries));
+    uint64_t offset = sizeof(header);
+    uint32_t names_size = 0;
+
+    header.magic = VFS_ARCHIVE_MAGIC;
+    header.version = VFS_ARCHIVE_VERSION;
+    header.entries_count = count;
+
+    fwrite(&header, sizeof(header), 1, fp);
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        write_padding(fp, &offset);
+
+        entries[i].offset = offset;
+        entries[i].size = files[i].size;
+        entries[i].original_size = files[i].original_size;
+        entries[i].name_offset = names_size;
+        entries[i].name_length = (uint32_t)strlen(files[i].name);
+        entries[i].compression = files[i].compression;
+
+        fwrite(files[i].data, 1, files[i].size, fp);
+
+        offset += files[i].size;
+        names_size += entries[i].name_length;
+    }
+
+    write_padding(fp, &offset);
+    header.entries_offset = offset;
+    fwrite(entries, sizeof(*entries), count, fp);
+
+    header.names_offset = header.entries_offset + (uint64_t)count * sizeof(*entries);
+
+    for(uint32_t i = 0; i < count; i++)
+        fwrite(files[i].name, 1, entries[i].name_length, fp);
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fp);
+
+    free(entries);
+
+    return !fclose(fp);
+}
+
+extern int
+main(int argc, char *argv[]) {
+    int lz4 = 0;
+    int i = 1;
+
+    if((i < argc) && !strcmp(argv[i], "-lz4"))
+    {
+        lz4 = 1;
+        i++;
+    }
+
+    if(argc - i < 3)
+    {
+        fprintf(stderr, "usage: %s [-lz4] output.pak root files...\n", argv[0]);
+        return 1;
+    }
+
+    const char *output = argv[i];
+    const char *root = argv[i + 1];
+    const size_t root_length = strlen(root);
+    const uint32_t count = (uint32_t)(argc - i - 2);
+    struct pack_file *files = (struct pack_file*)calloc(count, sizeof(*files));
+    size_t original_size = 0, stored_size = 0;
+    int result = 0;
+
+    for(uint32_t n = 0; n < count; n++)
+    {
+        const char *path = argv[i + 2 + n];
+
+        if(strncmp(path, root, root_length))
+        {
+            fprintf(stderr, "%s is not under %s\n", path, root);
+            goto cleanup;
+        }
+
+        if(!read_file(path, &files[n]))
+        {
+            fprintf(stderr, "Can't read %s\n", path);
+            goto cleanup;
+        }
+
+        files[n].name = path + root_length;
+
+        if(lz4)
+            compress_file(&files[n]);
+
+        original_size += files[n].original_size;
+        stored_size += files[n].size;
+    }
+
+    qsort(files, count, sizeof(*files), compare_files);
+
+    if(!write_archive(output, files, count))
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        goto cleanup;
+    }
+
+    printf("%s: %u files, %zu KiB -> %zu KiB\n", output, count, original_size / 1024, stored_size / 1024);
+    result = 1;
+
+cleanup:
+    for(uint32_t n = 0; n < count; n++)
+        free(files[n].data);
+
+    free(files);
+
+    return result ? 0 : 1;
+}
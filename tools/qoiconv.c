@@ -0,0 +1,98 @@
+/*
+ * Converts TGA textures to QOI, the pixels are checked to decode back unchanged
+ * usage: qoiconv input.tga output.qoi
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "targa.h"
+#include "qoi.h"
+
+static int channels_of(GLenum format)
+{
+    return format == GL_BGR ? 3 : (format == GL_BGRA ? 4 : 0);
+}
+
+// Decoded QOI is RGB(A), TGA is BGR(A)
+static int same_pixels(const uint8_t *bgr, const uint8_t *rgb, size_t count, int channels)
+{
+    for(size_t i = 0; i < count; i++, bgr += channels, rgb += channels)
+    {
+        if((bgr[0] != rgb[2]) || (bgr[1] != rgb[1]) || (bgr[2] != rgb[0]) || ((channels == 4) && (bgr[3] != rgb[3])))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int convert(const char *input, const char *output)
+{
+    GLuint iformat;
+    GLenum format;
+    GLsizei width, height;
+    uint8_t *pixels = (uint8_t*)load_targa(input, &iformat, &format, &width, &height);
+
+    if(!pixels)
+    {
+        fprintf(stderr, "Can't load %s\n", input);
+        return 0;
+    }
+
+    const int channels = channels_of(format);
+
+    if(!channels)
+    {
+        fprintf(stderr, "%s: only 24 and 32 bpp images can be stored as QOI\n", input);
+        free(pixels);
+        return 0;
+    }
+
+    size_t size = 0;
+    void *data = encode_qoi(pixels, width, height, format, &size);
+    int converted = 0;
+
+    if(data)
+    {
+        GLsizei w, h;
+        uint8_t *decoded = (uint8_t*)decode_qoi(data, size, &iformat, &format, &w, &h);
+
+        converted = decoded && (w == width) && (h == height) && same_pixels(pixels, decoded, (size_t)width * height, channels);
+
+        if(!converted)
+            fprintf(stderr, "%s: QOI round trip doesn't match\n", input);
+
+        free(decoded);
+    }
+
+    FILE *fp = converted ? fopen(output, "wb") : NULL;
+
+    if(converted && (!fp || (fwrite(data, 1, size, fp) != size)))
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        converted = 0;
+    }
+
+    if(fp && fclose(fp))
+        converted = 0;
+
+    if(converted)
+        printf("%s: %dx%d, %d channels, %zu KiB -> %zu KiB\n", output, width, height, channels,
+               (size_t)width * height * channels / 1024, size / 1024);
+
+    free(data);
+    free(pixels);
+
+    return converted;
+}
+
+extern int
+main(int argc, char *argv[]) {
+    if(argc != 3)
+    {
+        fprintf(stderr, "usage: %s input.tga output.qoi\n", argv[0]);
+        return 1;
+    }
+
+    return convert(argv[1], argv[2]) ? 0 : 1;
+}
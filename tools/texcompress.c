@@ -0,0 +1,388 @@
+/*
+ * Compresses TGA textures to BC1 (DXT1) or BC3 (DXT5) blocks with a full mip chain
+ * usage: texcompress [-bc1 | -bc3] [-linear] input.tga output.dds
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "targa.h"
+#include "mipmap.h"
+#include "dds.h"
+
+struct color
+{
+    float       c[3];               // r, g, b
+};
+
+static uint16_t to_565(const float *c)
+{
+    const int r = (int)(c[0] * 31.f / 255.f + 0.5f);
+    const int g = (int)(c[1] * 63.f / 255.f + 0.5f);
+    const int b = (int)(c[2] * 31.f / 255.f + 0.5f);
+
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void from_565(uint16_t v, float *c)
+{
+    const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+
+    c[0] = (float)((r << 3) | (r >> 2));
+    c[1] = (float)((g << 2) | (g >> 4));
+    c[2] = (float)((b << 3) | (b >> 2));
+}
+
+static float distance2(const float *a, const float *b)
+{
+    const float dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+
+    return dr * dr + dg * dg + db * db;
+}
+
+// Picks the nearest of the four palette entries per pixel, returns the total error
+static float fit_indices(const struct color *pixels, uint16_t c0, uint16_t c1, uint32_t *indices)
+{
+    float palette[4][3];
+
+    from_565(c0, palette[0]);
+    from_565(c1, palette[1]);
+
+    for(int k = 0; k < 3; k++)
+    {
+        palette[2][k] = (2.f * palette[0][k] + palette[1][k]) / 3.f;
+        palette[3][k] = (palette[0][k] + 2.f * palette[1][k]) / 3.f;
+    }
+
+    float error = 0.f;
+    *indices = 0;
+
+    for(int i = 0; i < 16; i++)
+    {
+        int best = 0;
+        float best_error = distance2(pixels[i].c, palette[0]);
+
+        for(int p = 1; p < 4; p++)
+        {
+            const float e = distance2(pixels[i].c, palette[p]);
+
+            if(e < best_error)
+            {
+                best = p;
+                best_error = e;
+            }
+        }
+
+        *indices |= (uint32_t)best << (2 * i);
+        error += best_error;
+    }
+
+    return error;
+}
+
+// Least squares endpoints for the given indices
+static int refine_endpoints(const struct color *pixels, uint32_t indices, float *e0, float *e1)
+{
+    static const float weights[4] = {1.f, 0.f, 2.f / 3.f, 1.f / 3.f};
+    float aa = 0.f, bb = 0.f, ab = 0.f, ax[3] = {0.f}, bx[3] = {0.f};
+
+    for(int i = 0; i < 16; i++)
+    {
+        const float a = weights[(indices >> (2 * i)) & 3], b = 1.f - a;
+
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+
+        for(int k = 0; k < 3; k++)
+        {
+            ax[k] += a * pixels[i].c[k];
+            bx[k] += b * pixels[i].c[k];
+        }
+    }
+
+    const float det = aa * bb - ab * ab;
+
+    if(fabsf(det) < 1e-6f)
+        return 0;
+
+    for(int k = 0; k < 3; k++)
+    {
+        e0[k] = fminf(fmaxf((ax[k] * bb - bx[k] * ab) / det, 0.f), 255.f);
+        e1[k] = fminf(fmaxf((bx[k] * aa - ax[k] * ab) / det, 0.f), 255.f);
+    }
+
+    return 1;
+}
+
+static void encode_color_block(const struct color *pixels, uint8_t *block)
+{
+    float mean[3] = {0.f};
+
+    for(int i = 0; i < 16; i++)
+        for(int k = 0; k < 3; k++)
+            mean[k] += pixels[i].c[k] / 16.f;
+
+    float cov[6] = {0.f};
+
+    for(int i = 0; i < 16; i++)
+    {
+        const float r = pixels[i].c[0] - mean[0], g = pixels[i].c[1] - mean[1], b = pixels[i].c[2] - mean[2];
+
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    // principal axis by power iteration
+    float axis[3] = {1.f, 1.f, 1.f};
+
+    for(int iteration = 0; iteration < 8; iteration++)
+    {
+        const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        const float m = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+
+        if(m < 1e-6f)
+            break;
+
+        axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+    }
+
+    int min_i = 0, max_i = 0;
+    float min_d = 1e30f, max_d = -1e30f;
+
+    for(int i = 0; i < 16; i++)
+    {
+        const float d = (pixels[i].c[0] - mean[0]) * axis[0] + (pixels[i].c[1] - mean[1]) * axis[1] + (pixels[i].c[2] - mean[2]) * axis[2];
+
+        if(d < min_d) { min_d = d; min_i = i; }
+        if(d > max_d) { max_d = d; max_i = i; }
+    }
+
+    uint16_t c0 = to_565(pixels[max_i].c), c1 = to_565(pixels[min_i].c);
+    uint32_t indices;
+    float error = fit_indices(pixels, c0, c1, &indices);
+
+    float e0[3], e1[3];
+
+    if(refine_endpoints(pixels, indices, e0, e1))
+    {
+        const uint16_t r0 = to_565(e0), r1 = to_565(e1);
+        uint32_t refined;
+
+        if(fit_indices(pixels, r0, r1, &refined) < error)
+        {
+            c0 = r0;
+            c1 = r1;
+            indices = refined;
+        }
+    }
+
+    // c0 > c1 selects the four colour mode
+    if(c0 < c1)
+    {
+        const uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+        indices ^= 0x55555555; // 0 <-> 1, 2 <-> 3
+    }
+    else if(c0 == c1)
+        indices = 0;
+
+    block[0] = c0 & 0xff; block[1] = c0 >> 8;
+    block[2] = c1 & 0xff; block[3] = c1 >> 8;
+    block[4] = indices & 0xff; block[5] = (indices >> 8) & 0xff;
+    block[6] = (indices >> 16) & 0xff; block[7] = indices >> 24;
+}
+
+static void encode_alpha_block(const uint8_t *alpha, uint8_t *block)
+{
+    int a0 = 0, a1 = 255;
+
+    for(int i = 0; i < 16; i++)
+    {
+        if(alpha[i] > a0) a0 = alpha[i];
+        if(alpha[i] < a1) a1 = alpha[i];
+    }
+
+    // a0 > a1 selects eight interpolated values
+    int palette[8] = {a0, a1};
+
+    for(int i = 1; i < 7; i++)
+        palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+
+    uint64_t indices = 0;
+
+    if(a0 != a1)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            int best = 0;
+
+            for(int p = 1; p < 8; p++)
+                if(abs(alpha[i] - palette[p]) < abs(alpha[i] - palette[best]))
+                    best = p;
+
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    block[0] = (uint8_t)a0;
+    block[1] = (uint8_t)a1;
+
+    for(int i = 0; i < 6; i++)
+        block[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// Blocks in DDS order, the top of the image first. The pixels are in GL order.
+static void encode_level(const uint8_t *pixels, int width, int height, int channels, uint32_t fourcc, uint8_t *out)
+{
+    for(int by = 0; by < height; by += 4)
+    {
+        for(int bx = 0; bx < width; bx += 4)
+        {
+            struct color colors[16];
+            uint8_t alpha[16];
+
+            // edge blocks repeat the last row and column
+            for(int i = 0; i < 16; i++)
+            {
+                const int x = bx + i % 4 < width ? bx + i % 4 : width - 1;
+                const int y = by + i / 4 < height ? by + i / 4 : height - 1;
+                const uint8_t *p = pixels + ((size_t)(height - 1 - y) * width + x) * channels;
+
+                colors[i].c[0] = p[channels >= 3 ? 2 : 0];
+                colors[i].c[1] = p[channels >= 3 ? 1 : 0];
+                colors[i].c[2] = p[0];
+                alpha[i] = channels == 4 ? p[3] : 255;
+            }
+
+            if(fourcc == DDS_FOURCC_DXT5)
+            {
+                encode_alpha_block(alpha, out);
+                out += 8;
+            }
+
+            encode_color_block(colors, out);
+            out += 8;
+        }
+    }
+}
+
+static int compress(const char *input, const char *output, uint32_t fourcc, int srgb)
+{
+    struct targa_image image;
+
+    if(!map_targa(input, &image))
+    {
+        fprintf(stderr, "Can't load %s\n", input);
+        return 0;
+    }
+
+    const int channels = image.iformat == GL_R8 ? 1 : (image.iformat == GL_RGB8 ? 3 : 4);
+
+    if(!fourcc)
+        fourcc = channels == 4 ? DDS_FOURCC_DXT5 : DDS_FOURCC_DXT1;
+
+    struct mip_chain chain;
+
+    if(!build_mip_chain(image.pixels, image.width, image.height, channels, 0, srgb, &chain))
+    {
+        unmap_targa(&image);
+        return 0;
+    }
+
+    unmap_targa(&image);
+
+    struct dds_header header = {0};
+
+    header.magic = DDS_MAGIC;
+    header.size = sizeof(header) - sizeof(header.magic);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.width = chain.width;
+    header.height = chain.height;
+    header.linear_size = (uint32_t)dds_level_size(fourcc, chain.width, chain.height);
+    header.levels = chain.levels;
+    header.format.size = sizeof(header.format);
+    header.format.flags = DDPF_FOURCC;
+    header.format.fourcc = fourcc;
+    header.caps[0] = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+    FILE *fp = fopen(output, "wb");
+
+    if(!fp)
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        free_mip_chain(&chain);
+        return 0;
+    }
+
+    int written = fwrite(&header, sizeof(header), 1, fp) == 1;
+    size_t compressed_size = 0;
+    int w = chain.width, h = chain.height;
+
+    for(int level = 0; written && (level < chain.levels); level++)
+    {
+        const size_t size = dds_level_size(fourcc, w, h);
+        uint8_t *blocks = (uint8_t*)malloc(size);
+
+        if(blocks)
+        {
+            encode_level(chain.pixels[level], w, h, channels, fourcc, blocks);
+            written = fwrite(blocks, 1, size, fp) == size;
+            free(blocks);
+        }
+        else
+            written = 0;
+
+        compressed_size += size;
+
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    // make would take a file cut short for an up to date one
+    if((fclose(fp) != 0) || !written)
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        remove(output);
+        free_mip_chain(&chain);
+        return 0;
+    }
+
+    printf("%s: %dx%d, %d levels, %s, %zu KiB -> %zu KiB\n", output, chain.width, chain.height, chain.levels,
+           fourcc == DDS_FOURCC_DXT1 ? "BC1" : "BC3", chain.size / 1024, compressed_size / 1024);
+
+    free_mip_chain(&chain);
+
+    return 1;
+}
+
+extern int
+main(int argc, char *argv[]) {
+    uint32_t fourcc = 0;
+    int srgb = 1;
+    int i = 1;
+
+    for(; (i < argc) && (argv[i][0] == '-'); i++)
+    {
+        if(!strcmp(argv[i], "-bc1"))
+            fourcc = DDS_FOURCC_DXT1;
+        else if(!strcmp(argv[i], "-bc3"))
+            fourcc = DDS_FOURCC_DXT5;
+        else if(!strcmp(argv[i], "-linear"))
+            srgb = 0;
+        else
+            break;
+    }
+
+    if(argc - i != 2)
+    {
+        fprintf(stderr, "usage: %s [-bc1 | -bc3] [-linear] input.tga output.dds\n", argv[0]);
+        return 1;
+    }
+
+    return compress(argv[i], argv[i + 1], fourcc, srgb) ? 0 : 1;
+}